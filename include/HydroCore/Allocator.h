@@ -0,0 +1,92 @@
+//
+// Created by Yucheng Soku on 2024/11/24.
+//
+
+#ifndef HYDROCOREPLAYER_ALLOCATOR_H
+#define HYDROCOREPLAYER_ALLOCATOR_H
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <vulkan/vulkan.h>
+
+namespace NextHydro {
+
+    struct Allocation {
+        VkDeviceMemory              memory          = VK_NULL_HANDLE;
+        VkDeviceSize                offset          = 0;
+        VkDeviceSize                size            = 0;
+        VkDeviceSize                blockSize       = 0;
+        VkMemoryPropertyFlags       memoryFlags     = 0;
+        uint32_t                    memoryType      = 0;
+        size_t                      blockIndex      = 0;
+        bool                        transient       = false;
+        void*                       mappedData      = nullptr;
+    };
+
+    // Utilisation of one memory type, the linear block of transient allocations is counted as one of its blocks
+    struct MemoryStatistics {
+        size_t                      blockCount          = 0;
+        size_t                      allocationCount     = 0;
+        VkDeviceSize                allocatedSize       = 0;
+        VkDeviceSize                usedSize            = 0;
+        size_t                      freeRangeCount      = 0;
+        VkDeviceSize                largestFreeRange    = 0;
+    };
+
+    // Device memory sub-allocator
+    // Buffers are carved from large blocks allocated per memory type (first fit, freed ranges are merged), so that the
+    // number of vkAllocateMemory calls stays far below maxMemoryAllocationCount. Transient allocations (upload staging)
+    // come from a linear block per memory type, which is rewound once all of its allocations are freed.
+    // Host visible blocks are mapped once when allocated and stay mapped until the allocator is destroyed.
+    class Allocator {
+    private:
+        struct MemoryBlock {
+            VkDeviceMemory                          memory          = VK_NULL_HANDLE;
+            VkDeviceSize                            size            = 0;
+            VkDeviceSize                            usedSize        = 0;
+            VkDeviceSize                            head            = 0;
+            size_t                                  allocationCount = 0;
+            void*                                   mappedData      = nullptr;
+            std::map<VkDeviceSize, VkDeviceSize>    freeRanges;
+        };
+
+        const VkDevice&                                 m_device;
+        VkPhysicalDeviceLimits                          m_limits {};
+        VkPhysicalDeviceMemoryProperties                m_memoryProperties {};
+        VkDeviceSize                                    m_blockSize;
+        uint32_t                                        m_deviceAllocationCount = 0;
+        std::vector<std::vector<MemoryBlock>>           m_blocks;
+        std::vector<MemoryBlock>                        m_transientBlocks;
+
+    public:
+        Allocator(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkDeviceSize blockSize = 64 * 1024 * 1024);
+        ~Allocator();
+
+        Allocator(const Allocator&) = delete;
+        Allocator& operator=(const Allocator&) = delete;
+
+        // Memory types having <preferredProperties> besides <properties> are used if there are any
+        Allocation allocate(const VkMemoryRequirements& requirements, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties = 0, bool transient = false);
+        void free(const Allocation& allocation);
+
+        [[nodiscard]] uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties = 0) const;
+        [[nodiscard]] const VkPhysicalDeviceLimits& limits() const { return m_limits; }
+
+        // Free ranges are the ones of the first-fit blocks (a block without allocations holds a single one once merged)
+        [[nodiscard]] MemoryStatistics statistics(uint32_t memoryType) const;
+        [[nodiscard]] uint32_t deviceAllocationCount() const { return m_deviceAllocationCount; }
+
+        // Utilisation of every memory type (blocks, allocated bytes, bytes in use, live allocations)
+        void report(std::ostream& os = std::cout) const;
+
+    private:
+        MemoryBlock createBlock(uint32_t memoryType, VkDeviceSize size);
+        void destroyBlock(MemoryBlock& block);
+        [[nodiscard]] VkDeviceSize alignmentOf(const VkMemoryRequirements& requirements, VkBufferUsageFlags usage, uint32_t memoryType) const;
+        static bool allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    };
+}
+
+#endif //HYDROCOREPLAYER_ALLOCATOR_H
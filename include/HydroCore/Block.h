@@ -6,21 +6,40 @@
 #define HYDROCOREPLAYER_BLOCK_H
 
 #include <map>
+#include <string>
 #include <vector>
 #include <cassert>
+#include <algorithm>
+#include <stdexcept>
 #include <iostream>
 #include "ValueType.h"
+#include "Types.h"
 #include "nlohmann/json.hpp"
 
 using Json = nlohmann::json;
 
 namespace NextHydro {
 
+    // Memory layout rules of a block array (the GLSL layout qualifier of the buffer using it)
+    // std140 rounds the stride of every element up to 16 bytes, std430 only to the alignment of the element
+    enum class Packing {
+        Std140,
+        Std430
+    };
+
+    Packing parsePacking(const std::string& packing);
+
+    // Length-only resources ({ "length": N } with an optional "fill" value) have no host memory,
+    // they are initialised on the device with the 32-bit <fillPattern> (fill is a float unless the layout is U32)
+    // Packed layouts (F16, U8, Mask) store several elements per 32-bit word with a stride of 4 under any packing
     struct Block {
         size_t size;
+        size_t stride;
+        Packing packing;
+        uint32_t fillPattern = 0;
         std::unique_ptr<char[]> buffer;
 
-        Block(const Json& typeList, const Json& jsonData);
+        Block(const Json& typeList, const Json& jsonData, Packing packing = Packing::Std140);
     };
 }
 
@@ -5,37 +5,29 @@
 #ifndef VKHYDROCORE_BUFFER_H
 #define VKHYDROCORE_BUFFER_H
 
+#include <string>
+#include <memory>
 #include <vector>
+#include <cstring>
+#include <cstdint>
 #include <utility>
+#include <algorithm>
 #include <stdexcept>
 #include <vulkan/vulkan.h>
 #include "config.h"
 #include "Types.h"
+#include "Trace.h"
+#include "Allocator.h"
 
 namespace NextHydro {
 
-    struct ScopedMemoryMapping {
-
-        const VkDevice&           device;
-        void*                     mappedData          = nullptr;
-        VkDeviceMemory            memory              = VK_NULL_HANDLE;
-
-        ScopedMemoryMapping(const VkDevice& device, VkDeviceMemory& memory, VkDeviceSize size, size_t offset = 0)
-                : device(device), memory(memory)
-       {
-            if (vkMapMemory(device, memory, offset, size, 0, &mappedData) != VK_SUCCESS) {
-                throw std::runtime_error("failed to map memory!");
-            }
-        };
-
-        ~ScopedMemoryMapping() {
-            if (mappedData) vkUnmapMemory(device, memory);
-        }
-    };
+    template<typename T>
+    class BufferView;
 
     class Buffer {
     private:
         const VkDevice&     m_device;
+        Allocator&          m_allocator;
 
     public:
         std::string                 name;
@@ -43,32 +35,105 @@ namespace NextHydro {
         VkBuffer                    buffer         = VK_NULL_HANDLE;
         VkDeviceMemory              memory         = VK_NULL_HANDLE;
         VkBufferUsageFlags          usageFlags     = 0;
+        VkMemoryPropertyFlags       memoryFlags    = 0;
+        VkDeviceSize                nonCoherentAtomSize = 1;
+        void*                       mappedData     = nullptr;
+        Allocation                  allocation     = {};
+        std::shared_ptr<Allocation> sharedAllocation;
         VkDescriptorBufferInfo      descriptorBufferInfo = {};
         VkDescriptorType            descriptorType = static_cast<VkDescriptorType>(0);
 
-        Buffer(const VkDevice& device, std::string name, const VkPhysicalDevice& physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
-                : m_device(device), name(std::move(name)), size(size)
+        // Memory types having <preferredProperties> besides <properties> are used if there are any (e.g. HOST_CACHED for host reads)
+        // Memory is sub-allocated by the allocator, host visible memory stays mapped until the buffer is released
+        // Transient buffers (e.g. upload staging) come from the linear arena of the allocator
+        Buffer(const VkDevice& device, std::string name, Allocator& allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties = 0, bool transient = false)
+                : m_device(device), m_allocator(allocator), name(std::move(name)), size(size)
         {
-            create(physicalDevice, usage, properties);
+            create(usage, properties, preferredProperties, transient);
+        }
+
+        // Alias buffer: created without memory, bound later to memory shared with other buffers (see bindAlias)
+        Buffer(const VkDevice& device, std::string name, Allocator& allocator, VkDeviceSize size, VkBufferUsageFlags usage)
+                : m_device(device), m_allocator(allocator), name(std::move(name)), size(size)
+        {
+            createBuffer(usage);
+        }
+
+        [[nodiscard]] VkMemoryRequirements getMemoryRequirements() const {
+
+            VkMemoryRequirements memRequirements;
+            vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
+            return memRequirements;
+        }
+
+        // Bind to memory owned by the caller, which may be bound to other buffers as well
+        void bindAlias(const std::shared_ptr<Allocation>& aliasAllocation) {
+
+            sharedAllocation = aliasAllocation;
+            bindMemory(*aliasAllocation);
+        }
+
+        [[nodiscard]] bool isAliased() const {
+            return sharedAllocation != nullptr;
         }
 
-        void writeData(char* pData) {
+        // Identity of the memory of the buffer, shared by all buffers aliasing it
+        [[nodiscard]] const void* aliasKey() const {
+            return sharedAllocation ? static_cast<const void*>(sharedAllocation.get()) : static_cast<const void*>(this);
+        }
+
+        // Destroy buffer and return its memory to the allocator (aliased memory is returned by its owner)
+        void release() {
+
+            if (buffer == VK_NULL_HANDLE) return;
+            vkDestroyBuffer(m_device, buffer, nullptr);
+            if (!sharedAllocation) m_allocator.free(allocation);
+            sharedAllocation.reset();
+            buffer = VK_NULL_HANDLE;
+            memory = VK_NULL_HANDLE;
+            mappedData = nullptr;
+        }
 
-            auto mappedMemory = ScopedMemoryMapping(m_device, memory, size);
-            memcpy(mappedMemory.mappedData, pData, static_cast<size_t>(size));
-        } // auto unmap
+        void writeData(const char* pData) {
+
+            memcpy(hostPointer(), pData, static_cast<size_t>(size));
+            flush();
+        }
 
         template<typename T>
         void readData(std::vector<T>& data) {
+
+            invalidate();
             data.resize(size / sizeof(T));
-            auto mappedMemory = ScopedMemoryMapping(m_device, memory, size);
-            memcpy(data.data(), mappedMemory.mappedData, static_cast<size_t>(size));
-        } // auto unmap
+            memcpy(data.data(), hostPointer(), static_cast<size_t>(size));
+        }
 
         void readFlag(Flag& flag, size_t offset = 0) {
-            auto mappedMemory = ScopedMemoryMapping(m_device, memory, 4, offset);
-            memcpy(flag.c, mappedMemory.mappedData, 4);
-        } // auto unmap
+            HYDRO_TRACE_SCOPE("readFlag");
+
+            invalidate(offset, 4);
+            memcpy(flag.c, static_cast<char*>(hostPointer()) + offset, 4);
+        }
+
+        // Typed view of the mapped memory, <offset> and <count> are given in elements of T
+        template<typename T>
+        BufferView<T> view(size_t offset = 0, size_t count = SIZE_MAX);
+
+        // Make device writes visible to the host (non-coherent memory only)
+        void invalidate(VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) const {
+
+            if (memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) return;
+            auto mappedRange = getMappedRange(offset, range);
+            vkInvalidateMappedMemoryRanges(m_device, 1, &mappedRange);
+        }
+
+        // Make host writes visible to the device (non-coherent memory only)
+        void flush(VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) const {
+
+            if (memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) return;
+            auto mappedRange = getMappedRange(offset, range);
+            vkFlushMappedMemoryRanges(m_device, 1, &mappedRange);
+        }
 
         VkDescriptorBufferInfo& getDescriptorBufferInfo(VkDeviceSize offset = 0, VkDeviceSize range = 0) {
 
@@ -84,25 +149,41 @@ namespace NextHydro {
 
     private:
 
-        static uint32_t findMemoryType(const VkPhysicalDevice& physicalDevice,uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+        [[nodiscard]] void* hostPointer() const {
 
-            VkPhysicalDeviceMemoryProperties memProperties;
-            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+            if (!mappedData) throw std::runtime_error("buffer <" + name + "> is not host visible!");
+            return mappedData;
+        }
 
-            uint32_t index;
-            for (index = 0; index < memProperties.memoryTypeCount; ++index) {
-                if ((typeFilter & (1 << index)) && (memProperties.memoryTypes[index].propertyFlags & properties) == properties) {
-                    return index;
-                }
-            }
-            return index;
+        // Ranges of non-coherent memory must be aligned to nonCoherentAtomSize
+        [[nodiscard]] VkMappedMemoryRange getMappedRange(VkDeviceSize offset, VkDeviceSize range) const {
+
+            VkMappedMemoryRange mappedRange {};
+            mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            mappedRange.memory = memory;
+
+            // Offsets are relative to the memory block, the allocation itself is aligned to nonCoherentAtomSize
+            if (range == VK_WHOLE_SIZE || offset + range > size) range = size - offset;
+            VkDeviceSize begin = allocation.offset + offset;
+            VkDeviceSize end = allocation.offset + offset + range;
+            mappedRange.offset = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+            end = (end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+            mappedRange.size = end >= allocation.blockSize ? VK_WHOLE_SIZE : end - mappedRange.offset;
+            return mappedRange;
         }
 
         void create(
-                const VkPhysicalDevice&         physicalDevice,
                 VkBufferUsageFlags              usage,
-                VkMemoryPropertyFlags           properties
+                VkMemoryPropertyFlags           properties,
+                VkMemoryPropertyFlags           preferredProperties,
+                bool                            transient
         ) {
+            createBuffer(usage);
+            bindMemory(m_allocator.allocate(getMemoryRequirements(), usage, properties, preferredProperties, transient));
+        }
+
+        void createBuffer(VkBufferUsageFlags usage) {
+
             usageFlags = usage;
             if          (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
             else if     (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -117,25 +198,57 @@ namespace NextHydro {
                 throw std::runtime_error("failed to create buffer!");
             }
 
-            VkMemoryRequirements memRequirements;
-            vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
+            descriptorBufferInfo.buffer = buffer;
+            descriptorBufferInfo.offset = 0;
+            descriptorBufferInfo.range = size;
+        }
+
+        void bindMemory(const Allocation& memoryAllocation) {
 
-            VkMemoryAllocateInfo allocInfo {};
-            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            allocInfo.memoryTypeIndex = Buffer::findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-            allocInfo.allocationSize = memRequirements.size;
+            allocation = memoryAllocation;
+            memory = allocation.memory;
+            memoryFlags = allocation.memoryFlags;
+            mappedData = allocation.mappedData;
+            nonCoherentAtomSize = m_allocator.limits().nonCoherentAtomSize;
 
-            if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate buffer memory");
+            if (vkBindBufferMemory(m_device, buffer, memory, allocation.offset) != VK_SUCCESS) {
+                throw std::runtime_error("failed to bind buffer memory!");
             }
+        }
+    };
 
-            vkBindBufferMemory(m_device, buffer, memory, 0);
+    // Span over the persistently mapped memory of a buffer, no data is copied
+    // Call invalidate() before reading device results and flush() after writing host data
+    template<typename T>
+    class BufferView {
+    private:
+        Buffer*             m_buffer;
+        size_t              m_offset;
+        size_t              m_count;
 
-            descriptorBufferInfo.buffer = buffer;
-            descriptorBufferInfo.offset = 0;
-            descriptorBufferInfo.range = size;
-        }
+    public:
+        BufferView(Buffer* buffer, size_t offset, size_t count)
+                : m_buffer(buffer), m_offset(offset), m_count(count)
+        {}
+
+        [[nodiscard]] T* data() const { return reinterpret_cast<T*>(m_buffer->mappedData) + m_offset; }
+        [[nodiscard]] size_t size() const { return m_count; }
+        [[nodiscard]] T* begin() const { return data(); }
+        [[nodiscard]] T* end() const { return data() + m_count; }
+        T& operator[](size_t index) const { return data()[index]; }
+
+        void invalidate() const { m_buffer->invalidate(m_offset * sizeof(T), m_count * sizeof(T)); }
+        void flush() const { m_buffer->flush(m_offset * sizeof(T), m_count * sizeof(T)); }
     };
+
+    template<typename T>
+    BufferView<T> Buffer::view(size_t offset, size_t count) {
+
+        if (!mappedData) throw std::runtime_error("buffer <" + name + "> is not host visible!");
+        size_t elementCount = static_cast<size_t>(size) / sizeof(T);
+        if (offset > elementCount) throw std::runtime_error("view offset is out of buffer <" + name + ">!");
+        return BufferView<T>(this, offset, std::min(count, elementCount - offset));
+    }
 }
 
 #endif //VKHYDROCORE_BUFFER_H
@@ -0,0 +1,218 @@
+//
+// Created by Yucheng Soku on 2024/11/20.
+//
+
+#ifndef HYDROCOREPLAYER_BUILTINSHADERS_H
+#define HYDROCOREPLAYER_BUILTINSHADERS_H
+
+#include <cstdint>
+
+namespace NextHydro::BuiltinShaders {
+
+    // Guard of a pollable command node
+    // Evaluates the termination condition of the node on the device and writes the indirect dispatch commands of its passes:
+    // the template group counts while the condition holds, zeros once it fails (so that iterations past the threshold are masked).
+    // The priming variant (PRIMING = 1) guards the first iteration of frames submitted without a host check: the very first one
+    // of a node has no flag produced by the node yet, so it proceeds while the control buffer is not primed (every guard primes it).
+    // Iterations of synchronous batches after the first one always check the condition.
+    // Every masked iteration is counted in <masked>, so that the host knows which half of each double-buffered pair is current.
+    // Control buffer layout (32-bit words): [ op, threshold, flagIndex, passCount, primed, masked, reserved x 2, active commands..., template commands... ]
+    constexpr const char* guard = R"(
+#version 450
+
+layout(set = 0, binding = 0, std430) readonly buffer flagBuffer {
+    float flags[];
+};
+
+layout(set = 0, binding = 1, std430) buffer controlBuffer {
+    uint op;
+    float threshold;
+    uint flagIndex;
+    uint passCount;
+    uint primed;
+    uint masked;
+    uint reserved[2];
+    uint commands[];
+} control;
+
+layout(constant_id = 0) const uint PRIMING = 0u;
+
+layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+
+bool proceed(float value) {
+
+    switch (control.op) {
+        case 0u: return value < control.threshold;
+        case 1u: return value <= control.threshold;
+        case 2u: return value > control.threshold;
+        case 3u: return value >= control.threshold;
+        default: return value == control.threshold;
+    }
+}
+
+void main() {
+
+    bool active = (PRIMING != 0u && control.primed == 0u) || proceed(flags[control.flagIndex]);
+    control.primed = 1u;
+    if (!active) control.masked += 1u;
+    uint commandWords = control.passCount * 3u;
+    for (uint i = 0u; i < commandWords; ++i) {
+        control.commands[i] = active ? control.commands[commandWords + i] : 0u;
+    }
+}
+)";
+
+    // Reduction pass (min, max or sum of a float storage)
+    // Dispatched in two stages of the same shader: the partial stage reduces <GROUP_SIZE * ITEMS_PER_INVOCATION> values per
+    // workgroup into one partial each, the final stage (one workgroup) reduces all partials into outputs[TARGET_INDEX].
+    // Workgroups combine values with subgroup arithmetic and shared memory if SUBGROUP_ARITHMETIC is set, by a shared memory tree otherwise.
+    // Values equal to IGNORED are left out of the partial stage if SKIP is set (e.g. cells of the boundary never written).
+    constexpr uint32_t reduceGroupSize = 256;
+    constexpr uint32_t reduceItemsPerInvocation = 16;
+    constexpr const char* reduce = R"(
+#version 450
+#if SUBGROUP_ARITHMETIC
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#endif
+
+#define GROUP_SIZE 256u
+#define ITEMS_PER_INVOCATION 16u
+
+layout(constant_id = 0) const uint FINAL = 0u;
+layout(constant_id = 1) const uint OPERATION = 0u;      // 0: min, 1: max, 2: sum
+layout(constant_id = 2) const uint COUNT = 1u;
+layout(constant_id = 3) const uint TARGET_INDEX = 0u;
+layout(constant_id = 4) const uint SKIP = 0u;
+layout(constant_id = 5) const float IGNORED = 0.0;
+
+layout(set = 0, binding = 0, std430) readonly buffer inputBuffer {
+    float inputs[];
+};
+
+layout(set = 0, binding = 1, std430) writeonly buffer outputBuffer {
+    float outputs[];
+};
+
+layout(local_size_x = 256, local_size_y = 1, local_size_z = 1) in;
+
+shared float partials[GROUP_SIZE];
+
+float identity() {
+
+    switch (OPERATION) {
+        case 0u: return uintBitsToFloat(0x7f800000u);
+        case 1u: return uintBitsToFloat(0xff800000u);
+        default: return 0.0;
+    }
+}
+
+float combine(float a, float b) {
+
+    switch (OPERATION) {
+        case 0u: return min(a, b);
+        case 1u: return max(a, b);
+        default: return a + b;
+    }
+}
+
+#if SUBGROUP_ARITHMETIC
+float subgroupCombine(float value) {
+
+    switch (OPERATION) {
+        case 0u: return subgroupMin(value);
+        case 1u: return subgroupMax(value);
+        default: return subgroupAdd(value);
+    }
+}
+#endif
+
+void main() {
+
+    uint local = gl_LocalInvocationID.x;
+
+    // Values of this invocation (coalesced: consecutive invocations read consecutive values)
+    uint first = local;
+    uint last = COUNT;
+    if (FINAL == 0u) {
+        first += gl_WorkGroupID.x * GROUP_SIZE * ITEMS_PER_INVOCATION;
+        last = min(COUNT, (gl_WorkGroupID.x + 1u) * GROUP_SIZE * ITEMS_PER_INVOCATION);
+    }
+
+    float value = identity();
+    for (uint index = first; index < last; index += GROUP_SIZE) {
+        float element = inputs[index];
+        if (FINAL == 0u && SKIP != 0u && element == IGNORED) continue;
+        value = combine(value, element);
+    }
+
+#if SUBGROUP_ARITHMETIC
+    // Subgroups first, then one value per subgroup through shared memory
+    value = subgroupCombine(value);
+    if (subgroupElect()) partials[gl_SubgroupID] = value;
+    barrier();
+
+    if (gl_SubgroupID == 0u) {
+        value = identity();
+        for (uint i = gl_SubgroupInvocationID; i < gl_NumSubgroups; i += gl_SubgroupSize) {
+            value = combine(value, partials[i]);
+        }
+        value = subgroupCombine(value);
+    }
+    bool leader = gl_SubgroupID == 0u && subgroupElect();
+#else
+    partials[local] = value;
+    barrier();
+    for (uint stride = GROUP_SIZE / 2u; stride > 0u; stride >>= 1u) {
+        if (local < stride) partials[local] = combine(partials[local], partials[local + stride]);
+        barrier();
+    }
+    value = partials[0];
+    bool leader = local == 0u;
+#endif
+
+    if (leader) outputs[FINAL == 0u ? gl_WorkGroupID.x : TARGET_INDEX] = value;
+}
+)";
+
+    // Include "hydrocore/packing.glsl"
+    // Element access of storages with a packed layout (F16, U8, Mask), declared as uint arrays in the shader.
+    // Neighbouring elements share a word, so element writes are atomic and only valid if no invocation writes the same element.
+    constexpr const char* packingIncludeName = "hydrocore/packing.glsl";
+    constexpr const char* packing = R"(
+#ifndef HYDROCORE_PACKING_GLSL
+#define HYDROCORE_PACKING_GLSL
+
+#define unpackF16(words, index)         (unpackHalf2x16(words[(index) >> 1u])[(index) & 1u])
+#define unpackU8(words, index)          ((words[(index) >> 2u] >> (((index) & 3u) << 3u)) & 0xffu)
+#define unpackMask(words, index)        ((words[(index) >> 5u] >> ((index) & 31u)) & 1u)
+
+#define setMask(words, index)           atomicOr(words[(index) >> 5u], 1u << ((index) & 31u))
+#define clearMask(words, index)         atomicAnd(words[(index) >> 5u], ~(1u << ((index) & 31u)))
+
+#define storeU8(words, index, value) { \
+    uint packingShift = ((index) & 3u) << 3u; \
+    atomicAnd(words[(index) >> 2u], ~(0xffu << packingShift)); \
+    atomicOr(words[(index) >> 2u], (uint(value) & 0xffu) << packingShift); \
+}
+
+#define storeF16(words, index, value) { \
+    uint packingShift = ((index) & 1u) << 4u; \
+    atomicAnd(words[(index) >> 1u], ~(0xffffu << packingShift)); \
+    atomicOr(words[(index) >> 1u], (packHalf2x16(vec2(value, 0.0)) & 0xffffu) << packingShift); \
+}
+
+#endif
+)";
+
+    // Includes resolved by the shader compiler (see BuiltinIncluder), their text is part of the key of cached SPIR-V
+    struct Include {
+        const char*     name;
+        const char*     content;
+    };
+    constexpr Include includes[] = {
+            { packingIncludeName, packing }
+    };
+}
+
+#endif //HYDROCOREPLAYER_BUILTINSHADERS_H
@@ -0,0 +1,75 @@
+//
+// Created by Yucheng Soku on 2024/11/29.
+//
+
+#ifndef HYDROCOREPLAYER_CLUSTER_H
+#define HYDROCOREPLAYER_CLUSTER_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Core.h"
+#include "ThreadPool.h"
+#include "nlohmann/json.hpp"
+
+using Json = nlohmann::json;
+namespace NextHydro {
+
+    // Row strip of the grid run by one core, rows are global grid rows
+    // The core holds rows [rowOffset, rowOffset + rowCount): its own rows [ownedBegin, ownedEnd) and ghost rows of its neighbours
+    struct Strip {
+        std::unique_ptr<Core>           core;
+        uint32_t                        rowOffset       = 0;
+        uint32_t                        rowCount        = 0;
+        uint32_t                        ownedBegin      = 0;
+        uint32_t                        ownedEnd        = 0;
+        std::unique_ptr<Buffer>         staging;
+    };
+
+    // Domain decomposition of a script over several logical devices [ split -> init -> step (exchange halos, combine reduction) -> ... ]
+    // The script describes its grid in a "decomposition" block, e.g.
+    // { "rows": 2001, "rowLength": 401, "halo": 2, "strip": { "uniform": "constants", "index": 10 },
+    //   "exchange": [ "hn", "qn_x", "qn_y" ], "reduce": { "storage": "scalars", "index": 0, "operation": "min" } }
+    // Every strip runs the script with row-major storages, row counts of compute scales and initial data cut to its rows.
+    // The uniform words at <strip.index> receive [ rowOffset, rowCount, ownedBegin, ownedEnd ] so that shaders work on global rows.
+    // Strips step at the same time on one thread each, once all of them finished the owned rows next to a neighbour are copied into its ghost rows (through host-visible memory),
+    // and the scalar of <reduce> (32-bit word <index> of the storage) is combined over all strips and written back to every strip.
+    // Exchanged storages hold one element per cell (packed types are not supported), and every strip needs a Vulkan device.
+    class Cluster {
+    public:
+        std::vector<Strip>              strips;
+
+    private:
+        uint32_t                        m_rows          = 0;
+        uint32_t                        m_rowLength     = 0;
+        uint32_t                        m_halo          = 0;
+        std::vector<std::string>        m_exchangeNames;
+        std::string                     m_reduceStorage;
+        uint32_t                        m_reduceIndex   = 0;
+        std::string                     m_reduceOperation;
+        std::unique_ptr<ThreadPool>     m_pool;
+
+    public:
+        // One strip per entry of <deviceIndices> (see Core), e.g. { -1, -1 } runs two logical devices on the best physical device
+        explicit Cluster(const std::vector<int32_t>& deviceIndices);
+        ~Cluster();
+
+        Cluster(const Cluster&) = delete;
+        Cluster& operator=(const Cluster&) = delete;
+
+        void                            initialization(const std::string& path);
+        bool                            step();
+
+    private:
+        [[nodiscard]] Json              stripScript(const Json& script, const Strip& strip) const;
+        void                            exchangeHalos();
+        void                            combineReduction();
+        void                            readRows(Strip& strip, const std::string& name, uint32_t row, uint32_t count, std::vector<char>& data);
+        void                            writeRows(Strip& strip, const std::string& name, uint32_t row, const std::vector<char>& data);
+        void                            readBytes(Strip& strip, Buffer* buffer, VkDeviceSize offset, VkDeviceSize size, std::vector<char>& data);
+        void                            writeBytes(Strip& strip, Buffer* buffer, VkDeviceSize offset, const std::vector<char>& data);
+        Buffer*                         stagingOf(Strip& strip, VkDeviceSize size);
+    };
+}
+
+#endif //HYDROCOREPLAYER_CLUSTER_H
@@ -5,8 +5,11 @@
 #ifndef HYDROCOREPLAYER_COMMANDNODE_H
 #define HYDROCOREPLAYER_COMMANDNODE_H
 
+#include <map>
+#include <tuple>
 #include <utility>
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <cassert>
 #include <iostream>
@@ -20,11 +23,13 @@ using Json = nlohmann::json;
 namespace NextHydro {
 
     struct ComputePass {
+        std::string                     name;
         std::string                     shader;
+        std::array<uint32_t, 3>         computeScale;
         std::array<uint32_t, 3>         groupCounts;
 
-        ComputePass(std::string& shader, std::array<uint32_t, 3>& groupCounts)
-                : shader(std::move(shader)), groupCounts(groupCounts)
+        ComputePass(std::string name, std::string& shader, std::array<uint32_t, 3>& computeScale, std::array<uint32_t, 3>& groupCounts)
+                : name(std::move(name)), shader(std::move(shader)), computeScale(computeScale), groupCounts(groupCounts)
         {}
     };
     struct ICommandNode {
@@ -32,6 +37,13 @@ namespace NextHydro {
         const VkDevice&                             device;
         std::vector<std::shared_ptr<ComputePass>>   passes;
 
+        // Command buffers recorded once and replayed by every execution, keyed by the number of iterations they hold,
+        // the frame they belong to (frame 0 is the synchronous recording, frames in flight use 1...N)
+        // and the parity of double-buffered storages at their first iteration (always 0 if the node does not flip them)
+        bool                                                            dirty = false;
+        bool                                                            flipping = false;
+        std::map<std::tuple<size_t, size_t, size_t>, VkCommandBuffer>   recordedCommandBuffers;
+
         explicit ICommandNode(std::string _name, const VkDevice& _device, const std::vector<std::shared_ptr<ComputePass>>& passes)
                 : name(std::move(_name)), device(_device), passes(passes)
         {}
@@ -39,8 +51,18 @@ namespace NextHydro {
         virtual bool isComplete() = 0;
         virtual char nodeType() = 0;
         virtual void tick() = 0;
-        virtual void postProcess(const VkCommandBuffer& commandBuffer) = 0;
+        virtual void postProcess(const VkCommandBuffer& commandBuffer, size_t frameSlot) = 0;
         virtual ~ICommandNode() = default;
+
+        // Batched execution (iterations recorded into one submission, checked for completeness only once)
+        virtual size_t clampIterations(size_t iterations) { return iterations; }
+        virtual void skip(size_t /*iterations*/) {}
+
+        // Replace passes of the node, the recorded command buffers are rebuilt before the next execution
+        void setPasses(const std::vector<std::shared_ptr<ComputePass>>& newPasses) {
+            passes = newPasses;
+            dirty = true;
+        }
     };
 
     struct IterableCommandNode : public ICommandNode {
@@ -61,46 +83,122 @@ namespace NextHydro {
 
         char nodeType() override { return 0b01; }
 
-        void postProcess(const VkCommandBuffer& commandBuffer) override {}
+        // The node is executed once more after every check returning false
+        size_t clampIterations(size_t iterations) override {
+            return std::min(iterations, count + 2 - currentFrame);
+        }
+
+        void skip(size_t iterations) override {
+            currentFrame += iterations;
+        }
+
+        void postProcess(const VkCommandBuffer& commandBuffer, size_t frameSlot) override {}
     };
 
     struct PollableCommandNode : public ICommandNode {
         char                                            type = 0b11;
         std::function<bool()>                           op;
+        uint32_t                                        opCode;
         Flag                                            flag;
         float_t                                         threshold;
         size_t                                          flagIndex;
         size_t                                          stagingIndex;
+        size_t                                          pollInterval = 1;
+        size_t                                          stepsSincePoll = 0;
         std::shared_ptr<Buffer>                         flagBuffer;
         Buffer*                                         stagingBuffer;
-        std::function<void(const VkCommandBuffer&)>     postProcessFunc;
+        std::shared_ptr<Buffer>                         controlBuffer;
+        std::shared_ptr<ComputePass>                    guardPass;
+        std::shared_ptr<ComputePass>                    primingGuardPass;
+        bool                                            submitted = false;
+        std::function<void(const VkCommandBuffer&, size_t)>    postProcessFunc;
 
         PollableCommandNode(std::string _name, const VkDevice& _device, const std::vector<std::shared_ptr<ComputePass>>& passes, const std::shared_ptr<Buffer>& _flagBuffer, Buffer* _stagingBuffer, const std::string& operation, size_t _flagIndex, float_t _threshold, bool isDiscrete)
                 : ICommandNode(std::move(_name), _device, passes), flagBuffer(_flagBuffer), stagingBuffer(_stagingBuffer), flagIndex(_flagIndex), threshold(_threshold), flag()
         {
             flag.f = 0.0;
+            // Operation codes are shared with the guard shader (see BuiltinShaders::guard)
             if (operation == "less") {
+                opCode = 0;
                 op = [this]() { return getData() < threshold; };
             } else if (operation == "lEqual") {
+                opCode = 1;
                 op = [this]() { return getData() <= threshold; };
             } else if (operation == "greater") {
+                opCode = 2;
                 op = [this]() { return getData() > threshold; };
             } else if (operation == "gEqual") {
+                opCode = 3;
                 op = [this]() { return getData() >= threshold; };
             } else {
+                opCode = 4;
                 op = [this]() { return getData() == threshold; };
             }
 
             if (isDiscrete) {
-                postProcessFunc = [this](const VkCommandBuffer& commandBuffer) { postProcessForDiscreteGPU(commandBuffer); };
+                postProcessFunc = [this](const VkCommandBuffer& commandBuffer, size_t frameSlot) { postProcessForDiscreteGPU(commandBuffer, frameSlot); };
                 stagingIndex = 0;
             } else {
-                postProcessFunc = [](const VkCommandBuffer& commandBuffer) {};
+                postProcessFunc = [](const VkCommandBuffer& commandBuffer, size_t) { makeFlagVisible(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT); };
                 stagingBuffer = flagBuffer.get();
                 stagingIndex = flagIndex;
             }
         }
 
+        // Initial content of the control buffer read by the guard
+        // Control buffers recreated after the node was submitted start primed, so that no guard proceeds without a check
+        [[nodiscard]] std::vector<uint32_t> controlData() const {
+
+            Flag thresholdFlag {};
+            thresholdFlag.f = threshold;
+
+            // Header: [ op, threshold, flagIndex, passCount, primed, masked, reserved x 2 ]
+            std::vector<uint32_t> data = { opCode, thresholdFlag.u, static_cast<uint32_t>(flagIndex), static_cast<uint32_t>(passes.size()), submitted ? 1u : 0u, 0, 0, 0 };
+            data.resize(controlHeaderWords + passes.size() * 6, 0);
+            for (size_t i = 0; i < passes.size(); ++i) {
+                for (size_t j = 0; j < 3; ++j) {
+                    data[controlHeaderWords + (passes.size() + i) * 3 + j] = passes[i]->groupCounts[j];
+                }
+            }
+            return data;
+        }
+
+        // Byte offset of the indirect dispatch command of a pass inside the control buffer
+        [[nodiscard]] VkDeviceSize commandOffset(size_t passIndex) const {
+            return (controlHeaderWords + passIndex * 3) * sizeof(uint32_t);
+        }
+
+        // Iterations masked by the guard since the control buffer was created, valid once the device finished all of them
+        [[nodiscard]] uint32_t maskedIterations() const {
+            Flag masked {};
+            controlBuffer->readFlag(masked, maskedWord * sizeof(uint32_t));
+            return masked.u;
+        }
+
+        // Copy the flag of every frame into its own slot of a host visible readback buffer,
+        // so that the flag of a finished frame can be read while later frames are still in flight
+        void useReadback(Buffer* readbackBuffer) {
+            stagingBuffer = readbackBuffer;
+            stagingIndex = 0;
+            postProcessFunc = [this](const VkCommandBuffer& commandBuffer, size_t frameSlot) { postProcessForDiscreteGPU(commandBuffer, frameSlot); };
+        }
+
+        void readFrame(size_t frameSlot) {
+            stagingIndex = frameSlot;
+        }
+
+        // GPU-driven termination: the guard masks iterations once the condition fails,
+        // so steps are submitted without waiting and the host reads the flag only every pollInterval steps
+        [[nodiscard]] bool isBlind() const {
+            return pollInterval > 1;
+        }
+
+        bool pollDue() {
+            if (++stepsSincePoll < pollInterval) return false;
+            stepsSincePoll = 0;
+            return true;
+        }
+
         [[nodiscard]] float getData() {
             stagingBuffer->readFlag(flag, stagingIndex * 4);
             std::cout << "Total time: " << flag.f << std::endl;
@@ -115,17 +213,40 @@ namespace NextHydro {
 
         char nodeType() override { return 0b11; }
 
-        void postProcess(const VkCommandBuffer& commandBuffer) override {
-            postProcessFunc(commandBuffer);
+        void postProcess(const VkCommandBuffer& commandBuffer, size_t frameSlot) override {
+            postProcessFunc(commandBuffer, frameSlot);
         }
 
-        void postProcessForDiscreteGPU(const VkCommandBuffer& commandBuffer) const {
+        void postProcessForDiscreteGPU(const VkCommandBuffer& commandBuffer, size_t frameSlot) const {
+
+            VkMemoryBarrier barrier {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
             VkBufferCopy copyRegion {};
             copyRegion.srcOffset = flagIndex * 4;
-            copyRegion.dstOffset = 0;
+            copyRegion.dstOffset = frameSlot * 4;
             copyRegion.size = 4;
             vkCmdCopyBuffer(commandBuffer, flagBuffer->buffer, stagingBuffer->buffer, 1, &copyRegion);
+
+            // The masked count of the guard is read from the control buffer itself
+            makeFlagVisible(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
         }
+
+        static void makeFlagVisible(const VkCommandBuffer& commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess) {
+
+            VkMemoryBarrier barrier {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+    private:
+        static constexpr size_t controlHeaderWords = 8;
+        static constexpr size_t maskedWord = 5;
     };
 }
 
@@ -6,19 +6,36 @@
 #define VKHYDROCORE_CORE_H
 
 #include <array>
+#include <future>
+#include <memory>
 #include <vector>
 #include <optional>
+#include <stdexcept>
 #include <unordered_map>
 #include <vulkan/vulkan.h>
 #include "Block.h"
 #include "Buffer.h"
+#include "Allocator.h"
+#include "UploadBatcher.h"
+#include "Profiler.h"
+#include "Trace.h"
 #include "Pipeline.h"
 #include "CommandNode.h"
+#include "CpuBackend.h"
+#include "Synchronization.h"
 #include "nlohmann/json.hpp"
 
 using Json = nlohmann::json;
 namespace NextHydro {
 
+    class ThreadPool;
+
+    // The machine has no Vulkan driver or no suitable device, Core then runs scripts on the CPU backend
+    // (other errors of the Vulkan setup, e.g. a missing validation layer, are reported as they are)
+    struct NoDeviceError : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
     class Core {
 
     private:
@@ -26,19 +43,48 @@ namespace NextHydro {
 
     public:
         bool                                isDiscrete                      =   false;
+        bool                                serializedExecution             =   false;
+        bool                                pendingSubmissions              =   false;
+        bool                                autotuneEnabled                 =   false;
+        bool                                subgroupSizeControl             =   false;
+        bool                                pipelineStatisticsQuery         =   false;
+        bool                                monotonicTimeDomain             =   false;
+        bool                                subgroupArithmetic              =   false;
         uint32_t                            currentFenceIndex               =   0;
-        uint32_t                            currentCommandBufferIndex       =   0;
+        uint32_t                            pingPongParity                  =   0;
+        uint32_t                            framesInFlight                  =   0;
+        uint64_t                            frameIndex                      =   0;
+        uint64_t                            timelineValue                   =   0;
+        uint64_t                            traceSession                    =   0;
         uint32_t                            maxComputeWorkGroupInvocations  =   0;
+        uint32_t                            minSubgroupSize                 =   0;
+        uint32_t                            maxSubgroupSize                 =   0;
+        uint32_t                            maxComputeWorkgroupSubgroups    =   0;
+        uint32_t                            timestampValidBits              =   0;
+        uint32_t                            autotuneRepetitions             =   10;
+        size_t                              aliasedBufferCount              =   0;
+        VkDeviceSize                        aliasedBufferSize               =   0;
+        std::string                         tuningDatabasePath;
+        Json                                tuningDatabase;
 
         VkDevice                            device                          =   VK_NULL_HANDLE;
         VkInstance                          instance                        =   VK_NULL_HANDLE;
         VkCommandPool                       commandPool                     =   VK_NULL_HANDLE;
         VkQueue                             computeQueue                    =   VK_NULL_HANDLE;
         VkDescriptorPool                    descriptorPool                  =   VK_NULL_HANDLE;
+        VkSemaphore                         timelineSemaphore               =   VK_NULL_HANDLE;
+        VkPipelineCache                     pipelineCache                   =   VK_NULL_HANDLE;
         VkPhysicalDevice                    physicalDevice                  =   VK_NULL_HANDLE;
+        PFN_vkGetCalibratedTimestampsEXT    getCalibratedTimestamps         =   nullptr;
+        std::unique_ptr<Allocator>          allocator;
+        std::unique_ptr<UploadBatcher>      uploader;
+        std::unique_ptr<Profiler>           profiler;
+        std::unique_ptr<CpuBackend>         cpuBackend;
 
         std::vector<std::unique_ptr<ICommandNode>>                          flowNode_list;
         std::vector<VkFence>                                                fences;
+        std::vector<uint64_t>                                               frameTimelineValues;
+        std::vector<std::shared_ptr<Allocation>>                            aliasAllocations;
         std::vector<VkCommandBuffer>                                        commandBuffers;
         std::vector<VkDescriptorSet>                                        descriptorSetPool;
         std::vector<VkCopyDescriptorSet>                                    descriptorCopySets;
@@ -48,37 +94,82 @@ namespace NextHydro {
         std::unordered_map<std::string, std::shared_ptr<Buffer>>            name_buffer_map;
         std::unordered_map<std::string, std::shared_ptr<ComputePipeline>>   name_pipeline_map;
         std::unordered_map<std::string, std::array<uint32_t, 2>>            buffer_descriptorSetPool_map;
+        std::unordered_map<std::string, size_t>                             buffer_stride_map;
+        std::unordered_map<std::string, std::string>                        buffer_pair_map;
+        std::unordered_map<std::string, std::vector<std::string>>           pass_stages_map;
 
     public:
-        Core();
+        // Device index running scripts on the host with native kernels (see CpuBackend)
+        static constexpr int32_t           hostDevice                      =   -2;
+
+        // <deviceIndex> selects a physical device by enumeration order, -1 picks the best scoring one
+        // (several cores on the same physical device are independent logical devices)
+        // Without a suitable device -1 falls back to the host, as does hostDevice on purpose
+        explicit Core(int32_t deviceIndex = -1);
         ~Core();
 
         // Running Mode <Script-Framework> [ parse -> run ]
         void                                parseScript(const std::string& path);
+        void                                parseScript(const Json& script);
         void                                runScript();
 
         // TODO: Implement running mode with simulation-framework
         // Running Mode <Simulation-Framework> [ initialization -> step -> ... -> step -> output ]
         void                                initialization(const std::string& path);
+        void                                initialization(const Json& script);
         void                                output();
         bool                                step();
+        bool                                stepBatch(uint32_t iterations);
 
         // Command Node execution
-        void                                executeNode(ICommandNode* node);
+        void                                executeNode(ICommandNode* node, size_t iterations = 1);
+        void                                setSerializedExecution(bool serialized);
+        void                                setFramesInFlight(uint32_t frames);
+        void                                setPollInterval(uint32_t interval);
+        static void                         setShaderCacheDirectory(const std::string& directory);
+
+        // Autotuning [ parse -> time candidate workgroup sizes of every pipeline -> keep winners in the tuning database ]
+        // The database of the device is loaded by every parse, the path defaults to the shader cache directory
+        void                                setAutotune(bool enabled, uint32_t repetitions = 10);
+        void                                setTuningDatabase(const std::string& path);
+
+        // Profiling [ enable -> run -> profile ] (timestamps around every dispatch, nothing is recorded when disabled)
+        // Toggling profiling re-records all nodes, statistics are kept per pass over a rolling window
+        void                                setProfiling(bool enabled, bool pipelineStatistics = false);
+        std::vector<PassStatistics>         profile();
+
+        // Tracing [ start -> run -> flush -> ... -> stop (or destruction) ] of host phases and GPU passes (enables profiling)
+        // An empty path stops the trace, GPU times are mapped onto the host clock by calibrated timestamps if available
+        // Destruction only stops the trace started by this core
+        void                                setTracing(const std::string& path);
+        void                                flushTrace();
 
         // Basic Operation for Computation
         void                                copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0) const;
-        static void                         dispatch(const VkCommandBuffer& commandBuffer, const ComputePipeline* pipeline, std::array<uint32_t, 3> groupCounts);
+        static void                         dispatch(const VkCommandBuffer& commandBuffer, const ComputePipeline* pipeline, std::array<uint32_t, 3> groupCounts, size_t parity = 0);
+        static void                         dispatchIndirect(const VkCommandBuffer& commandBuffer, const ComputePipeline* pipeline, VkBuffer indirectBuffer, VkDeviceSize offset, size_t parity = 0);
+        static void                         barrier(const VkCommandBuffer& commandBuffer, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, VkAccessFlags srcAccess, VkAccessFlags dstAccess);
         void                                updateBindings() const;
 
         // Basic Operation for Synchronization
         void                                idle() const;
+        void                                waitTimeline(uint64_t value) const;
+
+        // Pipeline cache is loaded at construction and saved at destruction (next to the shader cache)
+        void                                savePipelineCache() const;
 
         // Create Buffers
         [[nodiscard]] Buffer                createTempStagingBuffer(VkDeviceSize size) const;
         void                                createUniformBuffer(const std::string& name, Buffer*& uniformBuffer, Block& blockMemory) const;
         void                                createStorageBuffer(const std::string& name, Buffer*& storageBuffer, Block& blockMemory) const;
         void                                createStagingBuffer(const std::string& name, Buffer*& uniformBuffer, VkDeviceSize size) const;
+        void                                createControlBuffer(const std::string& name, Buffer*& controlBuffer, const std::vector<uint32_t>& data) const;
+        void                                reportMemory() const;
+
+        // Double-buffered storages [ "doubleBuffered": true ] are a pair of buffers behind the names <name> and <previous>,
+        // every iteration of a node binding them swaps the buffers behind both names (no copy, the other descriptor sets are bound)
+        // Returns the buffer a name refers to after all submitted iterations
+        [[nodiscard]] Buffer*               currentBuffer(const std::string& name) const;
 
     private:
 
@@ -86,17 +177,50 @@ namespace NextHydro {
         void                                createFence();
         void                                createInstance();
         void                                createCommandPool();
+        void                                createAllocator();
+        void                                createUploader();
         void                                createSyncObjects();
-        void                                pickPhysicalDevice();
+        void                                createPipelineCache();
+        [[nodiscard]] fs::path              pipelineCacheFile() const;
+        void                                calibrateTimestamps();
+        void                                pickPhysicalDevice(int32_t deviceIndex);
         void                                setupDebugMessenger();
         void                                createLogicalDevice();
-        void                                createCommandBuffer();
+        VkCommandBuffer                     createCommandBuffer();
+        void                                createGuard(PollableCommandNode* node);
+        void                                updateGuard(PollableCommandNode* node);
+        void                                aliasTransientBuffers(const std::vector<std::string>& transientNames, const Json& passes, const Json& flow);
+        std::vector<VkCopyDescriptorSet>    bindPipeline(const std::shared_ptr<ComputePipeline>& pipeline);
+        void                                destroyPipeline(ComputePipeline* pipeline) const;
+        std::array<std::future<std::shared_ptr<ComputePipeline>>, 2> createReduction(const Json& passInfo, ThreadPool& pool);
+        void                                bindReduction(const Json& passInfo);
+        [[nodiscard]] std::array<uint32_t, 3> groupCountsFor(const std::string& passName, const ComputePipeline* pipeline, const std::array<uint32_t, 3>& computeScale) const;
+
+        // Autotuning
+        void                                autotune();
+        void                                loadTuningDatabase();
+        void                                saveTuningDatabase() const;
+        [[nodiscard]] fs::path              tuningDatabaseFile() const;
+        [[nodiscard]] std::vector<std::pair<SpecializationConstants, uint32_t>> tuningCandidates(const ComputePipeline* pipeline, const std::array<uint32_t, 3>& computeScale) const;
+        double                              timeDispatch(const ComputePipeline* pipeline, const std::array<uint32_t, 3>& groupCounts, uint32_t repetitions, VkQueryPool queryPool) const;
 
         // Basic Operation for Node execution [ preheat -> begin -> end -> submit ]
-        VkCommandBuffer                     commandBegin();
-        void                                commandEnd();
+        VkCommandBuffer                     commandBegin(VkCommandBufferUsageFlags flags = 0);
+        static void                         commandEnd(const VkCommandBuffer& commandBuffer);
         void                                preheat();
-        void                                submit();
+        void                                submit(const VkCommandBuffer& commandBuffer);
+
+        // Asynchronous Node execution [ wait oldest frame -> check -> submit without waiting ]
+        bool                                stepAsync(uint32_t iterations);
+        void                                submitFrame(const std::vector<VkCommandBuffer>& frameCommandBuffers, uint64_t signalValue);
+        void                                createReadback(PollableCommandNode* node, uint32_t frames);
+
+        // Node recording [ record once -> replay many ]
+        VkCommandBuffer                     recordNode(ICommandNode* node, size_t iterations, size_t frame = 0);
+        void                                recordIteration(const VkCommandBuffer& commandBuffer, BarrierTracker& tracker, ICommandNode* node, bool guarded, bool priming, size_t parity);
+        void                                releaseRecordings(ICommandNode* node);
+        void                                flip(ICommandNode* node, size_t iterations);
+        void                                settleParity(PollableCommandNode* node);
     };
 }
 #endif //VKHYDROCORE_CORE_H
@@ -0,0 +1,110 @@
+//
+// Created by Yucheng Soku on 2024/11/30.
+//
+
+#ifndef HYDROCOREPLAYER_CPUBACKEND_H
+#define HYDROCOREPLAYER_CPUBACKEND_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <functional>
+#include <unordered_map>
+#include "ThreadPool.h"
+#include "nlohmann/json.hpp"
+
+using Json = nlohmann::json;
+namespace NextHydro {
+
+    class CpuBackend;
+
+    // Native counterpart of a compute shader, run for every pass using the pipeline of the same name
+    // <bindings> are the storages and uniforms the kernel reads or writes (double-buffered ones make its nodes swap them)
+    struct CpuKernel {
+        std::vector<std::string>                                    bindings;
+        std::function<void(CpuBackend&, const std::string&)>        run;
+    };
+
+    // Host execution of a script [ parse -> init -> step -> ... ], used when no Vulkan device is available
+    // Storages, uniforms, passes, reductions and command nodes follow the script model of Core: storages hold the blocks
+    // Core would upload, double-buffered storages swap after every iteration of a node binding them, and pollable nodes
+    // are checked after every batch. Pipelines are run by native kernels (see CpuKernels) instead of their shaders.
+    class CpuBackend {
+    private:
+        struct Node {
+            std::string                                 name;
+            std::vector<std::string>                    passes;
+            size_t                                      type            = 0;
+            size_t                                      count           = 0;
+            size_t                                      currentFrame    = 0;
+            std::string                                 flagStorage;
+            size_t                                      flagIndex       = 0;
+            std::string                                 operation;
+            float                                       flag            = 0.0f;
+            bool                                        flipping        = false;
+        };
+
+        struct Reduction {
+            std::string                                 source;
+            std::string                                 target;
+            std::string                                 operation;
+            uint32_t                                    targetIndex     = 0;
+            bool                                        skipping        = false;
+            float                                       ignored         = 0.0f;
+        };
+
+        std::vector<Node>                                                   m_nodes;
+        std::unordered_map<std::string, std::string>                        m_pass_shader_map;
+        std::unordered_map<std::string, Reduction>                          m_pass_reduction_map;
+        std::unordered_map<std::string, CpuKernel>                          m_kernels;
+
+    public:
+        uint32_t                                                            pingPongParity  = 0;
+        ThreadPool                                                          pool;
+
+        std::unordered_map<std::string, std::vector<uint32_t>>              name_storage_map;
+        std::unordered_map<std::string, size_t>                             storage_stride_map;
+        std::unordered_map<std::string, std::string>                        storage_pair_map;
+        std::unordered_map<std::string, Json>                               pipeline_defines_map;
+
+    public:
+        // Kernels of the shallow-water shaders are registered for the pipelines init, updateBoundaryHeight, updateFlow,
+        // updateHeight and updateTotalTime, <threadCount> includes the thread calling the backend
+        explicit CpuBackend(size_t threadCount = std::thread::hardware_concurrency());
+
+        CpuBackend(const CpuBackend&) = delete;
+        CpuBackend& operator=(const CpuBackend&) = delete;
+
+        void                                registerKernel(const std::string& pipeline, CpuKernel kernel);
+
+        void                                parseScript(const Json& script);
+        void                                runScript();
+        void                                initialization(const Json& script);
+        bool                                stepBatch(uint32_t iterations);
+        void                                reportMemory() const;
+
+        // Words of the storage a name refers to (swapped with its pair on odd parities), as T
+        template<typename T>
+        T* storage(const std::string& name) {
+
+            auto pairIt = storage_pair_map.find(name);
+            const auto& storageName = pairIt != storage_pair_map.end() && pingPongParity ? pairIt->second : name;
+            auto storageIt = name_storage_map.find(storageName);
+            if (storageIt == name_storage_map.end()) throw std::runtime_error("storage <" + name + "> does not exist!");
+            return reinterpret_cast<T*>(storageIt->second.data());
+        }
+
+        [[nodiscard]] size_t                storageSize(const std::string& name) const;
+
+    private:
+        void                                runNode(Node& node, size_t iterations);
+        void                                runPass(const std::string& passName);
+        void                                reduce(const Reduction& reduction);
+        [[nodiscard]] bool                  isComplete(Node& node);
+        void                                registerShallowWaterKernels();
+    };
+}
+
+#endif //HYDROCOREPLAYER_CPUBACKEND_H
@@ -0,0 +1,76 @@
+//
+// Created by Yucheng Soku on 2024/11/30.
+//
+
+#ifndef HYDROCOREPLAYER_CPUKERNELS_H
+#define HYDROCOREPLAYER_CPUKERNELS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace NextHydro::CpuKernels {
+
+    // Values of the uniform <constants> of the shallow-water shaders (rows of the strip are global grid rows)
+    struct Constants {
+        uint32_t        res_x           = 0;
+        uint32_t        res_y           = 0;
+        float           h_min           = 0.0f;
+        float           g               = 0.0f;
+        float           n               = 0.0f;
+        float           dx              = 0.0f;
+        float           dy              = 0.0f;
+        float           afa             = 0.0f;
+        float           sita            = 0.0f;
+        float           u               = 0.0f;
+        uint32_t        row_offset      = 0;
+        uint32_t        row_count       = 0;
+        uint32_t        owned_begin     = 0;
+        uint32_t        owned_end       = 0;
+    };
+
+    // Storages of the shaders, named as bound by them (z is F16, id_dx and id_dy are Mask, both packed into 32-bit words)
+    struct Fields {
+        float*          q_x             = nullptr;
+        float*          q_y             = nullptr;
+        float*          qn_x            = nullptr;
+        float*          qn_y            = nullptr;
+        float*          h               = nullptr;
+        float*          hn              = nullptr;
+        uint32_t*       z               = nullptr;
+        uint32_t*       id_dx           = nullptr;
+        uint32_t*       id_dy           = nullptr;
+    };
+
+    // Native counterparts of init.comp, updateBoundaryHeight.comp, updateFlow.comp and updateHeight.comp
+    // Row kernels tick the rows [rowBegin, rowEnd) of the strip (local rows), distinct row ranges can run concurrently.
+    // Cells are vectorised along rows: the kernels are built for AVX-512, AVX2 and scalar lanes, the best instruction set
+    // of the running CPU is used. Every lane computes exactly what the scalar path computes, so results do not depend on it.
+    const char*         instructionSet();
+
+    // Instruction sets the running CPU supports, best first (the last one is "scalar"),
+    // useInstructionSet switches the row kernels to one of them (not while kernels are running)
+    std::vector<std::string> instructionSets();
+    void                useInstructionSet(const std::string& name);
+
+    void                initRows(const Constants& constants, const Fields& fields, uint32_t rowBegin, uint32_t rowEnd);
+    void                initMasks(const Constants& constants, const Fields& fields);
+    void                boundaryHeight(const Constants& constants, const Fields& fields);
+
+    // Writes the smallest timestep of every row into <rowDt> (infinity for rows without one, see FUSED_CFL),
+    // or the timestep of every cell into <dt3> (0 for cells without one)
+    void                flowRows(const Constants& constants, const Fields& fields, float dt, uint32_t rowBegin, uint32_t rowEnd, float* rowDt, float* dt3);
+
+    // The boundary rows of q_y are copied before any row is ticked (the order the tiled shader reads them in)
+    void                heightBoundary(const Constants& constants, const Fields& fields);
+    void                heightRows(const Constants& constants, const Fields& fields, float dt, uint32_t rowBegin, uint32_t rowEnd);
+
+    // Row kernels compiled for one instruction set (see CpuKernelsImpl.h)
+    struct KernelTable {
+        const char*     name;
+        void            (*flowRows)(const Constants& constants, const Fields& fields, float dt, uint32_t rowBegin, uint32_t rowEnd, float* rowDt, float* dt3);
+        void            (*heightRows)(const Constants& constants, const Fields& fields, float dt, uint32_t rowBegin, uint32_t rowEnd);
+    };
+}
+
+#endif //HYDROCOREPLAYER_CPUKERNELS_H
@@ -0,0 +1,318 @@
+//
+// Created by Yucheng Soku on 2024/11/30.
+//
+
+#ifndef HYDROCOREPLAYER_CPUKERNELSIMPL_H
+#define HYDROCOREPLAYER_CPUKERNELSIMPL_H
+
+// Vectorised kernels of the CPU backend, included only by the kernel translation units of the instruction sets
+// (CpuKernelsScalar.cpp, CpuKernelsAvx2.cpp and CpuKernelsAvx512.cpp), each of them compiled for its instruction set.
+// The unit defines HYDROCORE_KERNELS_AVX2 or HYDROCORE_KERNELS_AVX512 for wide lanes (scalar lanes otherwise)
+// and HYDROCORE_KERNELS_NAMESPACE, the namespace the kernels are compiled into.
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstring>
+#include "CpuKernels.h"
+
+#if defined(HYDROCORE_KERNELS_AVX2) || defined(HYDROCORE_KERNELS_AVX512)
+#include <immintrin.h>
+#endif
+
+namespace NextHydro::CpuKernels::HYDROCORE_KERNELS_NAMESPACE {
+
+    namespace {
+
+        // Lanes ////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // min and max pick the second operand unless the first one is strictly smaller (greater), like minps and maxps
+
+        struct Scalar {
+            static constexpr uint32_t width = 1;
+            float v;
+        };
+
+        inline Scalar operator+(Scalar a, Scalar b) { return { a.v + b.v }; }
+        inline Scalar operator-(Scalar a, Scalar b) { return { a.v - b.v }; }
+        inline Scalar operator*(Scalar a, Scalar b) { return { a.v * b.v }; }
+        inline Scalar operator/(Scalar a, Scalar b) { return { a.v / b.v }; }
+        inline Scalar vmin(Scalar a, Scalar b) { return { a.v < b.v ? a.v : b.v }; }
+        inline Scalar vmax(Scalar a, Scalar b) { return { a.v > b.v ? a.v : b.v }; }
+        inline Scalar vabs(Scalar a) { return { std::fabs(a.v) }; }
+        inline Scalar vsqrt(Scalar a) { return { std::sqrt(a.v) }; }
+        inline void store(float* p, Scalar a) { *p = a.v; }
+        template<typename V> V load(const float* p);
+        template<typename V> V splat(float value);
+        template<> inline Scalar load<Scalar>(const float* p) { return { *p }; }
+        template<> inline Scalar splat<Scalar>(float value) { return { value }; }
+
+#if defined(HYDROCORE_KERNELS_AVX512)
+        struct Wide {
+            static constexpr uint32_t width = 16;
+            __m512 v;
+        };
+
+        inline Wide operator+(Wide a, Wide b) { return { _mm512_add_ps(a.v, b.v) }; }
+        inline Wide operator-(Wide a, Wide b) { return { _mm512_sub_ps(a.v, b.v) }; }
+        inline Wide operator*(Wide a, Wide b) { return { _mm512_mul_ps(a.v, b.v) }; }
+        inline Wide operator/(Wide a, Wide b) { return { _mm512_div_ps(a.v, b.v) }; }
+        inline Wide vmin(Wide a, Wide b) { return { _mm512_min_ps(a.v, b.v) }; }
+        inline Wide vmax(Wide a, Wide b) { return { _mm512_max_ps(a.v, b.v) }; }
+        inline Wide vabs(Wide a) { return { _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a.v), _mm512_set1_epi32(0x7fffffff))) }; }
+        inline Wide vsqrt(Wide a) { return { _mm512_sqrt_ps(a.v) }; }
+        inline void store(float* p, Wide a) { _mm512_storeu_ps(p, a.v); }
+        template<> inline Wide load<Wide>(const float* p) { return { _mm512_loadu_ps(p) }; }
+        template<> inline Wide splat<Wide>(float value) { return { _mm512_set1_ps(value) }; }
+#elif defined(HYDROCORE_KERNELS_AVX2)
+        struct Wide {
+            static constexpr uint32_t width = 8;
+            __m256 v;
+        };
+
+        inline Wide operator+(Wide a, Wide b) { return { _mm256_add_ps(a.v, b.v) }; }
+        inline Wide operator-(Wide a, Wide b) { return { _mm256_sub_ps(a.v, b.v) }; }
+        inline Wide operator*(Wide a, Wide b) { return { _mm256_mul_ps(a.v, b.v) }; }
+        inline Wide operator/(Wide a, Wide b) { return { _mm256_div_ps(a.v, b.v) }; }
+        inline Wide vmin(Wide a, Wide b) { return { _mm256_min_ps(a.v, b.v) }; }
+        inline Wide vmax(Wide a, Wide b) { return { _mm256_max_ps(a.v, b.v) }; }
+        inline Wide vabs(Wide a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+        inline Wide vsqrt(Wide a) { return { _mm256_sqrt_ps(a.v) }; }
+        inline void store(float* p, Wide a) { _mm256_storeu_ps(p, a.v); }
+        template<> inline Wide load<Wide>(const float* p) { return { _mm256_loadu_ps(p) }; }
+        template<> inline Wide splat<Wide>(float value) { return { _mm256_set1_ps(value) }; }
+#else
+        using Wide = Scalar;
+#endif
+
+        // pow has no vector instruction, every lane calls the scalar function
+        template<typename V>
+        V vpow(V base, float exponent) {
+
+            float lanes[V::width];
+            store(lanes, base);
+            for (auto& lane : lanes) lane = std::pow(lane, exponent);
+            return load<V>(lanes);
+        }
+
+        // Packed values /////////////////////////////////////////////////////////////////////////////////////////////////
+
+        // IEEE 754 binary16 to binary32 (the conversion of unpackHalf2x16, inverse of F16::floatToHalf)
+        float halfToFloat(uint32_t half) {
+
+            uint32_t sign = (half & 0x8000u) << 16;
+            uint32_t exponent = (half >> 10) & 0x1fu;
+            uint32_t mantissa = half & 0x3ffu;
+
+            uint32_t bits;
+            if (exponent == 0x1fu) {
+                bits = sign | 0x7f800000u | (mantissa << 13);
+            } else if (exponent) {
+                bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+            } else if (!mantissa) {
+                bits = sign;
+            } else {
+                // Subnormal halves are normal floats
+                exponent = 113u;
+                while (!(mantissa & 0x400u)) {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                bits = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+            }
+
+            float value;
+            std::memcpy(&value, &bits, sizeof(float));
+            return value;
+        }
+
+        inline float unpackF16(const uint32_t* words, size_t index) {
+            return halfToFloat((words[index >> 1] >> ((index & 1u) << 4)) & 0xffffu);
+        }
+
+        inline float unpackMask(const uint32_t* words, size_t index) {
+            return static_cast<float>((words[index >> 5] >> (index & 31u)) & 1u);
+        }
+
+        // Flow ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+        // Row being ticked by updateFlow, packed storages are unpacked into the scratch rows of the thread
+        struct FlowRow {
+            const Constants*    constants;
+            const Fields*       fields;
+            float               dt;
+            size_t              base;
+            const float*        hnC;
+            const float*        hnB;
+            const float*        qnxC;
+            const float*        qnyC;
+            const float*        qnyB;
+            const float*        qnyU;
+            const float*        zC;
+            const float*        zB;
+            const float*        maskX;
+            const float*        maskY;
+        };
+
+        struct Scratch {
+            std::vector<float>  zC;
+            std::vector<float>  zB;
+            std::vector<float>  maskX;
+            std::vector<float>  maskY;
+            std::vector<float>  zero;
+        };
+
+        // Tick fluxes of the cells [x, x + width) of a row, returns their timesteps (not masked by the domain)
+        template<typename V>
+        V tickFlow(const FlowRow& row, uint32_t x) {
+
+            const auto& c = *row.constants;
+            const auto& f = *row.fields;
+
+            // Fluxes of the last column are never advanced by updateHeight (see updateFlow.comp)
+            V qnx = x + V::width <= c.res_x ? load<V>(row.qnxC + x) : splat<V>(0.0f);
+            V qnxR = x + V::width < c.res_x ? load<V>(row.qnxC + x + 1) : splat<V>(0.0f);
+
+            V hnC = load<V>(row.hnC + x);
+            V hnL = load<V>(row.hnC + x - 1);
+            V hnB = load<V>(row.hnB + x);
+            V zc = load<V>(row.zC + x);
+            V zl = load<V>(row.zC + x - 1);
+            V zb = load<V>(row.zB + x);
+
+            V zero = splat<V>(0.0f);
+            V one = splat<V>(1.0f);
+            V epsilon = splat<V>(0.00001f);
+            V hMin = splat<V>(c.h_min);
+            V dryLimit = splat<V>(0.01f);
+            V dt = splat<V>(row.dt);
+            V minusG = splat<V>(-c.g);
+            V friction = splat<V>(c.g * row.dt * c.n * c.n);
+            V sita = splat<V>(c.sita);
+            V halfRest = splat<V>((1.0f - c.sita) / 2.0f);
+            float exponent = 7.0f / 3.0f;
+
+            // Tick q_x
+            V hf_x = vmax(hnC, hnL) - vmax(zc, zl);
+            V q1 = minusG * vmax(hf_x, zero) * dt * (hnC - hnL) / splat<V>(c.dx);
+            V q2 = one + friction * vabs(qnx / vpow(vmax(hf_x, epsilon), exponent));
+            V qx = (sita * qnx + halfRest * (load<V>(row.qnxC + x - 1) + qnxR) + q1) / q2;
+            qx = qx * load<V>(row.maskX + x);
+            qx = qx * vmax((hf_x - hMin) / (vabs(hf_x - hMin) + epsilon), zero);
+            store(f.q_x + row.base + x, qx);
+
+            // Tick q_y
+            V qnyC = load<V>(row.qnyC + x);
+            V hf_y = vmax(hnC, hnB) - vmax(zc, zb);
+            V q3 = minusG * vmax(hf_y, zero) * dt * (hnC - hnB) / splat<V>(c.dy);
+            V q4 = one + friction * vabs(qnyC / vpow(vmax(hf_y, epsilon), exponent));
+            V qy = (sita * qnyC + halfRest * (load<V>(row.qnyU + x) + load<V>(row.qnyB + x)) + q3) / q4;
+            qy = qy * load<V>(row.maskY + x);
+            qy = qy * vmax((hf_y - hMin) / (vabs(hf_y - hMin) + epsilon), zero);
+            store(f.q_y + row.base + x, qy);
+
+            // Timestep of the cells
+            V dt1 = splat<V>(c.afa * c.dx) / (vsqrt(splat<V>(c.g) * vmax(hf_x, dryLimit)) + vabs(qx) / vmax(hf_x, dryLimit));
+            V dt2 = splat<V>(c.afa * c.dy) / (vsqrt(splat<V>(c.g) * vmax(hf_y, dryLimit)) + vabs(qy) / vmax(hf_y, dryLimit));
+            return vmin(dt1, dt2);
+        }
+
+        // Height //////////////////////////////////////////////////////////////////////////////////////////////////////
+
+        template<typename V>
+        void tickHeight(const Constants& c, const Fields& f, float dt, size_t index, size_t upIndex) {
+
+            V dtv = splat<V>(dt);
+            V qx = (load<V>(f.q_x + index) - load<V>(f.q_x + index + 1)) * splat<V>(c.dy) * dtv;
+            V qy = (load<V>(f.q_y + index) - load<V>(f.q_y + upIndex)) * splat<V>(c.dx) * dtv;
+            store(f.h + index, load<V>(f.hn + index) + (qx + qy) / splat<V>(c.dx * c.dy));
+        }
+    }
+
+    void flowRows(const Constants& c, const Fields& f, float dt, uint32_t rowBegin, uint32_t rowEnd, float* rowDt, float* dt3) {
+
+        size_t rowLength = c.res_x + 1;
+        thread_local Scratch scratch;
+        scratch.zC.resize(rowLength);
+        scratch.zB.resize(rowLength);
+        scratch.maskX.resize(rowLength);
+        scratch.maskY.resize(rowLength);
+        scratch.zero.assign(rowLength, 0.0f);
+
+        const float infinity = std::numeric_limits<float>::infinity();
+        for (uint32_t localY = rowBegin; localY < rowEnd; ++localY) {
+            uint32_t globalY = localY + c.row_offset;
+            size_t base = localY * rowLength;
+
+            // The first row of a strip has no bottom neighbour
+            if (localY == 0 || globalY >= c.res_y + 1) {
+                if (rowDt) rowDt[localY] = infinity;
+                if (dt3 && globalY < c.res_y + 1) std::fill(dt3 + base, dt3 + base + rowLength, 0.0f);
+                continue;
+            }
+
+            for (size_t x = 0; x < rowLength; ++x) {
+                scratch.zC[x] = unpackF16(f.z, base + x);
+                scratch.zB[x] = unpackF16(f.z, base - rowLength + x);
+                scratch.maskX[x] = unpackMask(f.id_dx, base + x);
+                scratch.maskY[x] = unpackMask(f.id_dy, base + x);
+            }
+
+            // Cells outside the strip read as 0 (the upper neighbours of the last row)
+            FlowRow row {
+                    &c, &f, dt, base,
+                    f.hn + base, f.hn + base - rowLength,
+                    f.qn_x + base,
+                    f.qn_y + base, f.qn_y + base - rowLength,
+                    localY + 1 < c.row_count ? f.qn_y + base + rowLength : scratch.zero.data(),
+                    scratch.zC.data(), scratch.zB.data(), scratch.maskX.data(), scratch.maskY.data()
+            };
+
+            // Ghost rows are ticked by the strip owning them
+            bool counted = globalY < c.res_y && globalY >= c.owned_begin && globalY < c.owned_end;
+            float minimum = infinity;
+            auto account = [&](size_t x, float cellDt) {
+                if (!counted || x >= c.res_x) cellDt = 0.0f;
+                if (cellDt > 0.0f && cellDt < minimum) minimum = cellDt;
+                if (dt3) dt3[base + x] = cellDt;
+            };
+            if (dt3) dt3[base] = 0.0f;
+
+            // Full vectors while every lane has a right neighbour inside the row, the rest cell by cell
+            uint32_t x = 1;
+            for (; x + Wide::width < c.res_x; x += Wide::width) {
+                float lanes[Wide::width];
+                store(lanes, tickFlow<Wide>(row, x));
+                for (uint32_t i = 0; i < Wide::width; ++i) account(x + i, lanes[i]);
+            }
+            for (; x <= c.res_x; ++x) {
+                account(x, tickFlow<Scalar>(row, x).v);
+            }
+
+            if (rowDt) rowDt[localY] = minimum;
+        }
+    }
+
+    void heightRows(const Constants& c, const Fields& f, float dt, uint32_t rowBegin, uint32_t rowEnd) {
+
+        size_t rowLength = c.res_x + 1;
+        for (uint32_t localY = rowBegin; localY < rowEnd; ++localY) {
+            uint32_t globalY = localY + c.row_offset;
+
+            // The last row of a strip has no upper neighbour
+            if (globalY == 0 || globalY >= c.res_y || localY + 1 >= c.row_count) continue;
+
+            size_t base = localY * rowLength;
+            uint32_t x = 1;
+            for (; x + Wide::width <= c.res_x; x += Wide::width) {
+                tickHeight<Wide>(c, f, dt, base + x, base + rowLength + x);
+            }
+            for (; x < c.res_x; ++x) {
+                tickHeight<Scalar>(c, f, dt, base + x, base + rowLength + x);
+            }
+        }
+    }
+
+    extern const KernelTable kernels = { name, flowRows, heightRows };
+}
+
+#endif //HYDROCOREPLAYER_CPUKERNELSIMPL_H
@@ -5,9 +5,13 @@
 #ifndef VKHYDROCORE_PIPELINE_H
 #define VKHYDROCORE_PIPELINE_H
 
+#include <map>
+#include <array>
 #include <tuple>
 #include <vector>
 #include <fstream>
+#include <optional>
+#include <functional>
 #include <sstream>
 #include <iostream>
 #include <stdexcept>
@@ -15,6 +19,9 @@
 #include <unordered_map>
 #include "config.h"
 #include "Buffer.h"
+#include "ShaderCache.h"
+#include "BuiltinShaders.h"
+#include "Trace.h"
 #include "vulkan/vulkan.h"
 #include "spirv_reflect.h"
 #include "nlohmann/json.hpp"
@@ -45,7 +52,54 @@ using Json = nlohmann::json;
 namespace fs = std::filesystem;
 namespace NextHydro {
 
-    static std::vector<uint32_t> compileGLSLtoSPIRV(const std::string& glslCode, shaderc_shader_kind shaderType, bool debugInfo = false) {
+    // Signature of the compiler options below and the text of every built-in include, part of the key of cached SPIR-V
+    // (so that changing an include misses the cache like changing a shader does)
+    static const std::string& shaderCompileSignature() {
+
+        static const std::string signature = [] {
+            std::string text = "shaderc;O=size;spirv=1.5;env=vulkan1.3";
+            for (const auto& include : BuiltinShaders::includes) {
+                text += ";";
+                text += include.name;
+                text += "=";
+                text += include.content;
+            }
+            return text;
+        }();
+        return signature;
+    }
+
+    // Resolver of #include directives, only the built-in includes are available
+    class BuiltinIncluder : public shaderc::CompileOptions::IncluderInterface {
+    private:
+        struct Include {
+            std::string                 name;
+            std::string                 content;
+            shaderc_include_result      result;
+        };
+
+    public:
+        shaderc_include_result* GetInclude(const char* requestedSource, shaderc_include_type, const char*, size_t) override {
+
+            auto include = new Include {};
+            for (const auto& builtin : BuiltinShaders::includes) {
+                if (std::string(requestedSource) != builtin.name) continue;
+                include->name = requestedSource;
+                include->content = builtin.content;
+            }
+
+            // An empty source name reports the content as the error
+            if (include->name.empty()) include->content = "unknown include \"" + std::string(requestedSource) + "\"";
+            include->result = { include->name.c_str(), include->name.size(), include->content.c_str(), include->content.size(), include };
+            return &include->result;
+        }
+
+        void ReleaseInclude(shaderc_include_result* data) override {
+            delete static_cast<Include*>(data->user_data);
+        }
+    };
+
+    static std::vector<uint32_t> compileGLSLtoSPIRV(const std::string& glslCode, shaderc_shader_kind shaderType, bool debugInfo = false, const ShaderDefines& defines = {}) {
         shaderc::Compiler compiler;
         shaderc::CompileOptions options;
 
@@ -53,6 +107,10 @@ namespace NextHydro {
         if (debugInfo) options.SetGenerateDebugInfo();
         options.SetTargetSpirv(shaderc_spirv_version_1_5);
         options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+        for (const auto& [macro, value] : defines) {
+            options.AddMacroDefinition(macro, value);
+        }
+        options.SetIncluder(std::make_unique<BuiltinIncluder>());
 
         shaderc::CompilationResult result = compiler.CompileGlslToSpv(
                 glslCode.c_str(),
@@ -70,6 +128,236 @@ namespace NextHydro {
         return {result.cbegin(), result.cend()};
     }
 
+    // Access of a descriptor binding, storage blocks decorated NonWritable / NonReadable (readonly / writeonly in GLSL)
+    // on the variable or on all of their members are read-only / write-only, bindings not used by the shader have no access
+    static VkAccessFlags reflectBindingAccess(const SpvReflectDescriptorBinding& binding) {
+
+        if (!binding.accessed) return 0;
+        if (binding.descriptor_type == SPV_REFLECT_DESCRIPTOR_TYPE_UNIFORM_BUFFER) return VK_ACCESS_UNIFORM_READ_BIT;
+
+        auto decorated = [&binding](SpvReflectDecorationFlags flag) -> bool {
+            if (binding.decoration_flags & flag) return true;
+            if (binding.block.member_count == 0) return false;
+            for (uint32_t i = 0; i < binding.block.member_count; ++i) {
+                if (!(binding.block.members[i].decoration_flags & flag)) return false;
+            }
+            return true;
+        };
+
+        VkAccessFlags access = 0;
+        if (!decorated(SPV_REFLECT_DECORATION_NON_READABLE)) access |= VK_ACCESS_SHADER_READ_BIT;
+        if (!decorated(SPV_REFLECT_DECORATION_NON_WRITABLE)) access |= VK_ACCESS_SHADER_WRITE_BIT;
+        return access;
+    }
+
+    // Array stride declared by the shader for the trailing (runtime) array of a storage block, 0 if the block has no array
+    static uint32_t reflectArrayStride(const SpvReflectDescriptorBinding& binding) {
+
+        if (binding.descriptor_type != SPV_REFLECT_DESCRIPTOR_TYPE_STORAGE_BUFFER) return 0;
+        if (binding.block.member_count == 0) return 0;
+
+        const auto& member = binding.block.members[binding.block.member_count - 1];
+        return member.array.dims_count ? member.array.stride : 0;
+    }
+
+    // Workgroup size of the entry point and the specialization constant ids of its dimensions (-1 if a dimension is fixed)
+    struct WorkgroupSize {
+        std::array<uint32_t, 3>     size        = { 1, 1, 1 };
+        std::array<int32_t, 3>      specIds     = { -1, -1, -1 };
+    };
+
+    // Scan SPIR-V for the workgroup size of a compute shader, in order of precedence:
+    // the WorkgroupSize built-in (local_size_x_id in GLSL), the LocalSizeId execution mode and the LocalSize execution mode
+    static WorkgroupSize reflectWorkgroupSize(const std::vector<uint32_t>& spirvCode) {
+
+        enum : uint32_t {
+            OpExecutionMode = 16, OpConstant = 43, OpConstantComposite = 44, OpSpecConstant = 50,
+            OpSpecConstantComposite = 51, OpDecorate = 71, OpExecutionModeId = 331,
+            DecorationSpecId = 1, DecorationBuiltIn = 11, BuiltInWorkgroupSize = 25,
+            ExecutionModeLocalSize = 17, ExecutionModeLocalSizeId = 38
+        };
+
+        WorkgroupSize workgroupSize;
+        uint32_t builtinId = 0;
+        std::array<uint32_t, 3> localSizeIds {};
+        bool hasLocalSizeIds = false;
+        std::unordered_map<uint32_t, uint32_t> constants;
+        std::unordered_map<uint32_t, uint32_t> specIds;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> composites;
+
+        // Header takes 5 words, every instruction starts with (word count << 16 | opcode)
+        for (size_t i = 5; i < spirvCode.size();) {
+            uint32_t wordCount = spirvCode[i] >> 16;
+            uint32_t opcode = spirvCode[i] & 0xffffu;
+            if (wordCount == 0 || i + wordCount > spirvCode.size()) break;
+            const uint32_t* operands = &spirvCode[i + 1];
+
+            switch (opcode) {
+                case OpDecorate:
+                    if (wordCount >= 4 && operands[1] == DecorationBuiltIn && operands[2] == BuiltInWorkgroupSize) builtinId = operands[0];
+                    if (wordCount >= 4 && operands[1] == DecorationSpecId) specIds[operands[0]] = operands[2];
+                    break;
+                case OpConstant:
+                case OpSpecConstant:
+                    if (wordCount >= 4) constants[operands[1]] = operands[2];
+                    break;
+                case OpConstantComposite:
+                case OpSpecConstantComposite:
+                    composites[operands[1]] = std::vector<uint32_t>(operands + 2, operands + wordCount - 1);
+                    break;
+                case OpExecutionMode:
+                    if (wordCount >= 6 && operands[1] == ExecutionModeLocalSize) workgroupSize.size = { operands[2], operands[3], operands[4] };
+                    break;
+                case OpExecutionModeId:
+                    if (wordCount >= 6 && operands[1] == ExecutionModeLocalSizeId) {
+                        localSizeIds = { operands[2], operands[3], operands[4] };
+                        hasLocalSizeIds = true;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            i += wordCount;
+        }
+
+        // Resolve dimensions given by (specialization) constants
+        if (builtinId && composites.count(builtinId) && composites[builtinId].size() == 3) {
+            const auto& ids = composites[builtinId];
+            localSizeIds = { ids[0], ids[1], ids[2] };
+            hasLocalSizeIds = true;
+        }
+        if (hasLocalSizeIds) {
+            for (size_t d = 0; d < 3; ++d) {
+                auto constantIt = constants.find(localSizeIds[d]);
+                if (constantIt == constants.end()) throw std::runtime_error("workgroup size of shader is not a constant.");
+                workgroupSize.size[d] = constantIt->second;
+
+                auto specIt = specIds.find(localSizeIds[d]);
+                if (specIt != specIds.end()) workgroupSize.specIds[d] = static_cast<int32_t>(specIt->second);
+            }
+        }
+        return workgroupSize;
+    }
+
+    // Values of specialization constants (constant id -> 32-bit value)
+    using SpecializationConstants = std::map<uint32_t, uint32_t>;
+
+    // Scan SPIR-V for the bytes of shared memory (Workgroup variables) a compute shader declares under <specialization>,
+    // array lengths may be specialization constant expressions (e.g. shared float tile[(gl_WorkGroupSize.x + 2) * ...])
+    // Members are packed without padding, lengths the scan can not evaluate count as 0
+    static uint64_t reflectSharedMemorySize(const std::vector<uint32_t>& spirvCode, const SpecializationConstants& specialization) {
+
+        enum : uint32_t {
+            OpTypeBool = 20, OpTypeInt = 21, OpTypeFloat = 22, OpTypeVector = 23, OpTypeMatrix = 24, OpTypeArray = 28,
+            OpTypeStruct = 30, OpTypePointer = 32, OpConstant = 43, OpConstantComposite = 44, OpSpecConstant = 50,
+            OpSpecConstantComposite = 51, OpSpecConstantOp = 52, OpVariable = 59, OpDecorate = 71, OpCompositeExtract = 81,
+            OpIAdd = 128, OpISub = 130, OpIMul = 132, OpUDiv = 134, OpSDiv = 135, OpUMod = 137,
+            DecorationSpecId = 1, StorageClassWorkgroup = 4
+        };
+
+        std::unordered_map<uint32_t, std::vector<uint32_t>> types;
+        std::unordered_map<uint32_t, uint32_t> pointers;
+        std::unordered_map<uint32_t, uint32_t> constants;
+        std::unordered_map<uint32_t, uint32_t> specIds;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> composites;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> operations;
+        std::vector<uint32_t> variables;
+
+        for (size_t i = 5; i < spirvCode.size();) {
+            uint32_t wordCount = spirvCode[i] >> 16;
+            uint32_t opcode = spirvCode[i] & 0xffffu;
+            if (wordCount == 0 || i + wordCount > spirvCode.size()) break;
+            const uint32_t* operands = &spirvCode[i + 1];
+
+            switch (opcode) {
+                case OpTypeBool: case OpTypeInt: case OpTypeFloat: case OpTypeVector: case OpTypeMatrix: case OpTypeArray: case OpTypeStruct:
+                    types[operands[0]] = { opcode };
+                    types[operands[0]].insert(types[operands[0]].end(), operands, operands + wordCount - 1);
+                    break;
+                case OpTypePointer:
+                    if (wordCount >= 4 && operands[1] == StorageClassWorkgroup) pointers[operands[0]] = operands[2];
+                    break;
+                case OpDecorate:
+                    if (wordCount >= 4 && operands[1] == DecorationSpecId) specIds[operands[0]] = operands[2];
+                    break;
+                case OpConstant:
+                case OpSpecConstant:
+                    if (wordCount >= 4) constants[operands[1]] = operands[2];
+                    break;
+                case OpConstantComposite:
+                case OpSpecConstantComposite:
+                    composites[operands[1]] = std::vector<uint32_t>(operands + 2, operands + wordCount - 1);
+                    break;
+                case OpSpecConstantOp:
+                    if (wordCount >= 4) operations[operands[1]] = std::vector<uint32_t>(operands + 2, operands + wordCount - 1);
+                    break;
+                case OpVariable:
+                    if (wordCount >= 4 && operands[2] == StorageClassWorkgroup) variables.push_back(operands[0]);
+                    break;
+                default:
+                    break;
+            }
+            i += wordCount;
+        }
+
+        // Scalar value of a (specialization) constant, specialized values replace the defaults
+        std::function<std::optional<uint64_t>(uint32_t)> evaluate = [&](uint32_t id) -> std::optional<uint64_t> {
+            auto specIt = specIds.find(id);
+            if (specIt != specIds.end()) {
+                auto valueIt = specialization.find(specIt->second);
+                if (valueIt != specialization.end()) return valueIt->second;
+            }
+            auto constantIt = constants.find(id);
+            if (constantIt != constants.end()) return constantIt->second;
+
+            auto operationIt = operations.find(id);
+            if (operationIt == operations.end() || operationIt->second.size() < 2) return std::nullopt;
+            const auto& operation = operationIt->second;
+            if (operation[0] == OpCompositeExtract) {
+                auto compositeIt = composites.find(operation[1]);
+                if (operation.size() < 3 || compositeIt == composites.end() || operation[2] >= compositeIt->second.size()) return std::nullopt;
+                return evaluate(compositeIt->second[operation[2]]);
+            }
+            if (operation.size() < 3) return std::nullopt;
+            auto a = evaluate(operation[1]);
+            auto b = evaluate(operation[2]);
+            if (!a || !b) return std::nullopt;
+            switch (operation[0]) {
+                case OpIAdd: return *a + *b;
+                case OpISub: return *a - *b;
+                case OpIMul: return *a * *b;
+                case OpUDiv: case OpSDiv: return *b ? std::optional<uint64_t>(*a / *b) : std::nullopt;
+                case OpUMod: return *b ? std::optional<uint64_t>(*a % *b) : std::nullopt;
+                default: return std::nullopt;
+            }
+        };
+
+        std::function<uint64_t(uint32_t)> sizeOf = [&](uint32_t typeId) -> uint64_t {
+            auto typeIt = types.find(typeId);
+            if (typeIt == types.end()) return 0;
+            const auto& type = typeIt->second;
+            switch (type[0]) {
+                case OpTypeBool: return 4;
+                case OpTypeInt: case OpTypeFloat: return type.size() > 2 ? type[2] / 8 : 0;
+                case OpTypeVector: case OpTypeMatrix: return type.size() > 3 ? sizeOf(type[2]) * type[3] : 0;
+                case OpTypeArray: return type.size() > 3 ? sizeOf(type[2]) * evaluate(type[3]).value_or(0) : 0;
+                default: {
+                    uint64_t size = 0;
+                    for (size_t m = 2; m < type.size(); ++m) size += sizeOf(type[m]);
+                    return size;
+                }
+            }
+        };
+
+        // Variables are kept by the id of their pointer type
+        uint64_t size = 0;
+        for (auto pointerId : variables) {
+            auto pointerIt = pointers.find(pointerId);
+            if (pointerIt != pointers.end()) size += sizeOf(pointerIt->second);
+        }
+        return size;
+    }
+
     class ReflectShaderModule {
     public:
         SpvReflectShaderModule          prototypeModule{};
@@ -93,13 +381,28 @@ namespace NextHydro {
     public:
         ReflectShaderModule*    reflector;
         VkShaderModule          module      = VK_NULL_HANDLE;
+        WorkgroupSize           workgroupSize;
+        std::string             cacheKey;
+        std::vector<uint32_t>   spirvCode;
 
-        ShaderModule(const VkDevice& device, const std::string& glslCode)
+        // Optimised code and code with debug info (names for reflection) are read from the shader cache if possible
+        ShaderModule(const VkDevice& device, const std::string& glslCode, const ShaderDefines& defines = {})
                 : m_device(device)
         {
-            auto spirvCode = compileGLSLtoSPIRV(glslCode, shaderc_compute_shader);
-            auto spirvCodeDebug = compileGLSLtoSPIRV(glslCode, shaderc_compute_shader, true);
+            std::vector<uint32_t> spirvCodeDebug;
+            auto key = cacheKey = ShaderCache::key(glslCode, defines, shaderCompileSignature());
+            if (!ShaderCache::load(key, "opt", spirvCode) || !ShaderCache::load(key, "reflect", spirvCodeDebug)) {
+                HYDRO_TRACE_SCOPE("compileShader");
+                spirvCode = compileGLSLtoSPIRV(glslCode, shaderc_compute_shader, false, defines);
+                spirvCodeDebug = compileGLSLtoSPIRV(glslCode, shaderc_compute_shader, true, defines);
+                if (spirvCode.empty() || spirvCodeDebug.empty()) {
+                    throw std::runtime_error("failed to compile shader!");
+                }
+                ShaderCache::store(key, "opt", spirvCode);
+                ShaderCache::store(key, "reflect", spirvCodeDebug);
+            }
             reflector = new ReflectShaderModule(spirvCodeDebug);
+            workgroupSize = reflectWorkgroupSize(spirvCode);
             createShaderModule(spirvCode);
         }
 
@@ -173,8 +476,29 @@ namespace NextHydro {
         std::vector<VkDescriptorSet>                descriptorSets;
         std::vector<VkWriteDescriptorSet>           descriptorSetWrite;
         std::vector<VkDescriptorSetLayout>          descriptorSetLayout;
+        std::vector<Buffer*>                        bindingResources;
         std::vector<std::string>                    bindingResourceNames;
+        std::vector<VkAccessFlags>                  bindingResourceAccess;
+        std::vector<uint32_t>                       bindingArrayStride;
         std::vector<std::array<uint32_t, 2>>        bindingResourceInfo;
+        std::array<uint32_t, 3>                     localSize               =           { 1, 1, 1 };
+
+        // Variant of the descriptor sets (and bound buffers) with the buffers of double-buffered storages swapped,
+        // used by odd iterations of nodes flipping them, empty if the pipeline binds no double-buffered storage
+        std::vector<VkDescriptorSet>                flippedDescriptorSets;
+        std::vector<Buffer*>                        flippedBindingResources;
+
+        [[nodiscard]] bool flips() const {
+            return !flippedDescriptorSets.empty();
+        }
+
+        [[nodiscard]] const std::vector<VkDescriptorSet>& descriptorSetsOf(size_t parity) const {
+            return parity && flips() ? flippedDescriptorSets : descriptorSets;
+        }
+
+        [[nodiscard]] const std::vector<Buffer*>& bindingResourcesOf(size_t parity) const {
+            return parity && flips() ? flippedBindingResources : bindingResources;
+        }
 
         size_t findDescriptorSetWriteIndex(uint32_t dstSet, uint32_t dstBinding) {
             DescriptorKey key = { dstSet, dstBinding };
@@ -193,13 +517,22 @@ namespace NextHydro {
 
     class ComputePipeline : public IPipeline {
     public:
-        ShaderModule* computeShaderModule = nullptr;
+        ShaderModule*               computeShaderModule     = nullptr;
+
+        // Build inputs, kept to create variants of the pipeline (e.g. by the autotuner)
+        std::string                 source;
+        ShaderDefines               defines;
+        SpecializationConstants     specialization;
+        uint32_t                    requiredSubgroupSize    = 0;
+        uint64_t                    sharedMemorySize        = 0;
 
     public:
-        ComputePipeline(const VkDevice& device, const char* name, const char *glslCode)
-                : IPipeline(device, name)
+        // <requiredSubgroupSize> is only honoured if subgroupSizeControl is enabled on the device, 0 leaves it to the driver
+        ComputePipeline(const VkDevice& device, const char* name, const char *glslCode, VkPipelineCache pipelineCache = VK_NULL_HANDLE,
+                        const ShaderDefines& defines = {}, const SpecializationConstants& specialization = {}, uint32_t requiredSubgroupSize = 0)
+                : IPipeline(device, name), source(glslCode), defines(defines), specialization(specialization), requiredSubgroupSize(requiredSubgroupSize)
         {
-            create(glslCode);
+            create(pipelineCache);
         }
 
         ~ComputePipeline() {
@@ -207,10 +540,18 @@ namespace NextHydro {
         }
 
     private:
-        void create(const char *glslCode) {
+        void create(VkPipelineCache pipelineCache) {
 
             // Build shader module
-            computeShaderModule = new ShaderModule(m_device, glslCode);
+            computeShaderModule = new ShaderModule(m_device, source, defines);
+
+            // Local size declared by the shader, dimensions given by specialization constants take the specialized values
+            const auto& workgroupSize = computeShaderModule->workgroupSize;
+            for (size_t d = 0; d < 3; ++d) {
+                auto specIt = specialization.find(static_cast<uint32_t>(workgroupSize.specIds[d]));
+                localSize[d] = workgroupSize.specIds[d] >= 0 && specIt != specialization.end() ? specIt->second : workgroupSize.size[d];
+            }
+            sharedMemorySize = reflectSharedMemorySize(computeShaderModule->spirvCode, specialization);
 
             // Generate descriptor set layout for pipeline from shader module
             computeShaderModule->generateDescriptorSetLayout(descriptorSetLayout);
@@ -229,7 +570,28 @@ namespace NextHydro {
             pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
             pipelineInfo.stage = computeShaderModule->getShaderStageCreateInfo();
             pipelineInfo.layout = pipelineLayout;
-            if (vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+
+            // Specialization constants
+            std::vector<uint32_t> specializationData;
+            std::vector<VkSpecializationMapEntry> specializationEntries;
+            for (const auto& [constantId, value] : specialization) {
+                specializationEntries.push_back({ constantId, static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t)), sizeof(uint32_t) });
+                specializationData.push_back(value);
+            }
+            VkSpecializationInfo specializationInfo {};
+            specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+            specializationInfo.pMapEntries = specializationEntries.data();
+            specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+            specializationInfo.pData = specializationData.data();
+            if (!specialization.empty()) pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+
+            // Required subgroup size
+            VkPipelineShaderStageRequiredSubgroupSizeCreateInfo subgroupSizeInfo {};
+            subgroupSizeInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO;
+            subgroupSizeInfo.requiredSubgroupSize = requiredSubgroupSize;
+            if (requiredSubgroupSize) pipelineInfo.stage.pNext = &subgroupSizeInfo;
+
+            if (vkCreateComputePipelines(m_device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create compute pipeline!");
             }
 
@@ -237,9 +599,12 @@ namespace NextHydro {
             const auto& reflector = computeShaderModule->reflector->prototypeModule;
             descriptorSets.resize(computeShaderModule->reflector->prototypeModule.descriptor_set_count);
 
-            // Reflect binding info (name, set index and binding index used by the shader)
+            // Reflect binding info (name, access, set index and binding index used by the shader)
+            bindingResources.resize(reflector.descriptor_binding_count, nullptr);
             bindingResourceInfo.resize(reflector.descriptor_binding_count);
             bindingResourceNames.resize(reflector.descriptor_binding_count);
+            bindingResourceAccess.resize(reflector.descriptor_binding_count);
+            bindingArrayStride.resize(reflector.descriptor_binding_count);
             for (size_t i = 0; i < reflector.descriptor_binding_count; ++i) {
 
                 if (reflector.descriptor_bindings[i].name != std::string("")) {
@@ -253,8 +618,9 @@ namespace NextHydro {
                 uint32_t binding = reflector.descriptor_bindings[i].binding;
                 uint32_t set = reflector.descriptor_bindings[i].set;
                 bindingResourceInfo[i] = { set, binding };
+                bindingResourceAccess[i] = reflectBindingAccess(reflector.descriptor_bindings[i]);
+                bindingArrayStride[i] = reflectArrayStride(reflector.descriptor_bindings[i]);
             }
-            const int m = 0;
         }
     };
 }
@@ -0,0 +1,93 @@
+//
+// Created by Yucheng Soku on 2024/11/28.
+//
+
+#ifndef HYDROCOREPLAYER_PROFILER_H
+#define HYDROCOREPLAYER_PROFILER_H
+
+#include <map>
+#include <deque>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+namespace NextHydro {
+
+    // Rolling statistics of the dispatches of one pass (percentiles and mean over the last <window> dispatches)
+    struct PassStatistics {
+        std::string                 pass;
+        uint64_t                    count           = 0;
+        double                      meanMs          = 0.0;
+        double                      p50Ms           = 0.0;
+        double                      p99Ms           = 0.0;
+        double                      totalMs         = 0.0;
+        uint64_t                    invocations     = 0;    // compute shader invocations of the last dispatch (pipeline statistics only)
+    };
+
+    // GPU profiler of recorded command buffers
+    // Every dispatch of a recording is enclosed by two timestamp queries (and optionally a pipeline statistics query)
+    // in query pools owned by that recording. Results are read without waiting once a submission has completed, and
+    // before the recording is submitted again, so the queue never stalls for them.
+    class Profiler {
+    private:
+        struct QuerySet {
+            VkQueryPool                 timestampPool   = VK_NULL_HANDLE;
+            VkQueryPool                 statisticsPool  = VK_NULL_HANDLE;
+            uint32_t                    capacity        = 0;
+            bool                        pending         = false;
+            std::vector<std::string>    passes;
+        };
+
+        struct Samples {
+            uint64_t                    count           = 0;
+            double                      totalMs         = 0.0;
+            uint64_t                    invocations     = 0;
+            std::deque<double>          windowMs;
+        };
+
+        const VkDevice&                                     m_device;
+        double                                              m_timestampPeriod;
+        uint64_t                                            m_timestampMask;
+        bool                                                m_pipelineStatistics;
+        size_t                                              m_window;
+        bool                                                m_calibrated            = false;
+        uint64_t                                            m_calibrationTicks      = 0;
+        uint64_t                                            m_calibrationHostNs     = 0;
+        uint64_t                                            m_droppedSubmissions    = 0;
+        std::unordered_map<VkCommandBuffer, QuerySet>       m_querySets;
+        std::map<std::string, Samples>                      m_samples;
+
+    public:
+        Profiler(const VkDevice& device, float timestampPeriod, uint32_t timestampValidBits, bool pipelineStatistics, size_t window = 1024);
+        ~Profiler();
+
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        // Recording [ begin recording -> (begin dispatch -> dispatch -> end dispatch) x N -> release with the command buffer ]
+        void beginRecording(VkCommandBuffer commandBuffer, size_t maxDispatches);
+        void beginDispatch(VkCommandBuffer commandBuffer, const std::string& pass);
+        void endDispatch(VkCommandBuffer commandBuffer);
+        void release(VkCommandBuffer commandBuffer);
+
+        // Submission, results of the previous submission of the command buffer are collected first
+        void submitted(VkCommandBuffer commandBuffer);
+
+        // Read the results of all completed submissions
+        void collect();
+
+        // Pair of a device timestamp and the host time (Trace::now) of the same moment, dispatches are traced once set
+        void calibrate(uint64_t deviceTicks, uint64_t hostNs);
+
+        [[nodiscard]] std::vector<PassStatistics> statistics() const;
+        [[nodiscard]] uint64_t droppedSubmissions() const { return m_droppedSubmissions; }
+        void reset();
+
+    private:
+        bool collect(QuerySet& querySet);
+        [[nodiscard]] uint64_t hostTime(uint64_t deviceTicks) const;
+    };
+}
+
+#endif //HYDROCOREPLAYER_PROFILER_H
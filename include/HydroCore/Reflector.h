@@ -75,6 +75,18 @@ namespace NextHydro {
                 .method("alignment", &NextHydro::F32::alignment)
                 .method("getBufferFromJson", &NextHydro::F32::getBufferFromJson);
 
+        rttr::registration::class_<NextHydro::F16>("F16")
+                .method("bits", &NextHydro::F16::bits)
+                .method("encode", &NextHydro::F16::encode);
+
+        rttr::registration::class_<NextHydro::U8>("U8")
+                .method("bits", &NextHydro::U8::bits)
+                .method("encode", &NextHydro::U8::encode);
+
+        rttr::registration::class_<NextHydro::Mask>("Mask")
+                .method("bits", &NextHydro::Mask::bits)
+                .method("encode", &NextHydro::Mask::encode);
+
         rttr::registration::class_<NextHydro::Vec2>("Vec2")
                 .constructor<float, float>()
                 .method("size", &NextHydro::Vec2::size)
@@ -0,0 +1,41 @@
+//
+// Created by Yucheng Soku on 2024/11/26.
+//
+
+#ifndef HYDROCOREPLAYER_SHADERCACHE_H
+#define HYDROCOREPLAYER_SHADERCACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <filesystem>
+
+namespace NextHydro {
+
+    // Preprocessor definitions (name, value) passed to the shader compiler
+    using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+    // Content-addressed cache of compiled SPIR-V on disk
+    // Entries are keyed by a hash of the GLSL source, the defines and the compiler signature (options and target
+    // environment), so that any change of them is a miss and stale entries are never read. Every key holds several
+    // variants (e.g. optimised code and code with debug info for reflection).
+    // The directory is $HYDROCORE_SHADER_CACHE if set, <temp>/HydroCore/shader-cache otherwise; an empty one disables the cache.
+    class ShaderCache {
+    public:
+        static void setDirectory(const std::filesystem::path& directory);
+        static const std::filesystem::path& directory();
+
+        static std::string key(const std::string& source, const ShaderDefines& defines, const std::string& signature);
+
+        // Return false if the variant is not cached (or the file is not valid SPIR-V)
+        static bool load(const std::string& key, const std::string& variant, std::vector<uint32_t>& spirv);
+        static void store(const std::string& key, const std::string& variant, const std::vector<uint32_t>& spirv);
+
+    private:
+        static std::filesystem::path& directoryStorage();
+        static std::filesystem::path entryPath(const std::string& key, const std::string& variant);
+    };
+}
+
+#endif //HYDROCOREPLAYER_SHADERCACHE_H
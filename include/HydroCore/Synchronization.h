@@ -0,0 +1,169 @@
+//
+// Created by Yucheng Soku on 2024/11/21.
+//
+
+#ifndef HYDROCOREPLAYER_SYNCHRONIZATION_H
+#define HYDROCOREPLAYER_SYNCHRONIZATION_H
+
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+#include "Buffer.h"
+
+namespace NextHydro {
+
+    struct ResourceAccess {
+        const Buffer*               buffer;
+        VkPipelineStageFlags        stage;
+        VkAccessFlags               access;
+    };
+
+    // Barrier tracker of one command buffer recording
+    // Every command declares the buffers it accesses before being recorded, and the tracker emits buffer barriers
+    // only for true hazards (RAW, WAR, WAW) against the commands recorded before it.
+    // Buffers aliasing the same memory share one state, hazards between them are resolved with memory barriers.
+    class BarrierTracker {
+    private:
+        struct ResourceState {
+            VkPipelineStageFlags    writeStage      = 0;
+            VkAccessFlags           writeAccess     = 0;
+            VkPipelineStageFlags    readStages      = 0;
+            VkPipelineStageFlags    visibleStages   = 0;
+            VkAccessFlags           visibleAccess   = 0;
+        };
+
+        static constexpr VkAccessFlags writeAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+        bool                                                m_serialized;
+        std::unordered_map<const void*, ResourceState>      m_states;
+
+    public:
+        explicit BarrierTracker(bool serialized = false)
+                : m_serialized(serialized)
+        {}
+
+        // Work submitted before this recording is unknown, so the recording starts with one full barrier
+        void begin(const VkCommandBuffer& commandBuffer) {
+
+            m_states.clear();
+            fullBarrier(commandBuffer);
+        }
+
+        void synchronize(const VkCommandBuffer& commandBuffer, const std::vector<ResourceAccess>& accesses) {
+
+            if (m_serialized) {
+                fullBarrier(commandBuffer);
+                return;
+            }
+
+            // Find hazards against the state before the command
+            VkPipelineStageFlags srcStages = 0;
+            VkPipelineStageFlags dstStages = 0;
+            std::vector<VkBufferMemoryBarrier> barriers;
+            std::vector<VkMemoryBarrier> memoryBarriers;
+            std::vector<std::pair<const void*, VkAccessFlags>> barrierResources;
+            for (const auto& access : accesses) {
+                const auto& state = m_states[access.buffer->aliasKey()];
+                VkPipelineStageFlags stages = 0;
+                VkAccessFlags srcAccess = 0;
+
+                // RAW, WAW: the last write is not visible to this access yet
+                if (state.writeStage && ((access.stage & ~state.visibleStages) || (access.access & ~state.visibleAccess))) {
+                    stages |= state.writeStage;
+                    srcAccess |= state.writeAccess;
+                }
+
+                // WAR: reads since the last barrier must be finished before overwriting
+                if ((access.access & writeAccessMask) && state.readStages) {
+                    stages |= state.readStages;
+                }
+                if (!stages) continue;
+                srcStages |= stages;
+                dstStages |= access.stage;
+                barrierResources.emplace_back(access.buffer->aliasKey(), access.access);
+
+                // Previous accesses may have gone through another buffer aliasing the memory
+                if (access.buffer->isAliased()) {
+                    VkMemoryBarrier memoryBarrier {};
+                    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                    memoryBarrier.srcAccessMask = srcAccess;
+                    memoryBarrier.dstAccessMask = access.access;
+                    memoryBarriers.emplace_back(memoryBarrier);
+                    continue;
+                }
+
+                VkBufferMemoryBarrier barrier {};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = srcAccess;
+                barrier.dstAccessMask = access.access;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer = access.buffer->buffer;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                barriers.emplace_back(barrier);
+            }
+
+            if (!barrierResources.empty()) {
+                vkCmdPipelineBarrier(
+                        commandBuffer, srcStages, dstStages, 0,
+                        static_cast<uint32_t>(memoryBarriers.size()), memoryBarriers.data(),
+                        static_cast<uint32_t>(barriers.size()), barriers.data(),
+                        0, nullptr
+                );
+
+                // Reads covered by the execution dependency are finished
+                auto executed = withEarlierStages(srcStages);
+                for (auto& pair : m_states) {
+                    if (!(pair.second.readStages & ~executed)) pair.second.readStages = 0;
+                }
+
+                // Writes covered by the memory dependency are visible
+                for (const auto& resource : barrierResources) {
+                    auto& state = m_states[resource.first];
+                    state.visibleStages |= dstStages;
+                    state.visibleAccess |= resource.second;
+                }
+            }
+
+            // Apply accesses of the command
+            for (const auto& access : accesses) {
+                auto& state = m_states[access.buffer->aliasKey()];
+                if (access.access & writeAccessMask) {
+                    state.writeStage = access.stage;
+                    state.writeAccess = access.access & writeAccessMask;
+                    state.readStages = 0;
+                    state.visibleStages = 0;
+                    state.visibleAccess = 0;
+                } else {
+                    state.readStages |= access.stage;
+                }
+            }
+        }
+
+    private:
+        static VkPipelineStageFlags withEarlierStages(VkPipelineStageFlags stages) {
+
+            // Indirect command reads logically happen before the compute stage of the same dispatch
+            if (stages & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+            return stages;
+        }
+
+        static void fullBarrier(const VkCommandBuffer& commandBuffer) {
+
+            VkMemoryBarrier barrier {};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            vkCmdPipelineBarrier(
+                    commandBuffer,
+                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    0, 1, &barrier, 0, nullptr, 0, nullptr
+            );
+        }
+    };
+}
+
+#endif //HYDROCOREPLAYER_SYNCHRONIZATION_H
@@ -0,0 +1,193 @@
+//
+// Created by Yucheng Soku on 2024/11/27.
+//
+
+#ifndef HYDROCOREPLAYER_THREADPOOL_H
+#define HYDROCOREPLAYER_THREADPOOL_H
+
+#include <deque>
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+namespace NextHydro {
+
+    // Fixed-size pool of worker threads executing tasks and data-parallel loops
+    // Tasks given to submit() run in submission order, their results (and exceptions) are returned through the future.
+    // Chunks of parallelFor() are dealt to a deque per thread: a worker takes chunks from the back of its own deque and steals
+    // from the front of others, so that uneven chunks (rows of different cost, busy cores) are balanced without a shared queue.
+    // Destroying the pool finishes all queued tasks before joining the workers.
+    class ThreadPool {
+    private:
+        struct Queue {
+            std::mutex                                  mutex;
+            std::deque<std::function<void()>>           tasks;
+        };
+
+        bool                                            m_stopping      = false;
+        std::atomic<size_t>                             m_pending       { 0 };
+        std::mutex                                      m_mutex;
+        std::condition_variable                         m_condition;
+        std::queue<std::function<void()>>               m_tasks;
+        std::vector<std::unique_ptr<Queue>>             m_queues;
+        std::vector<std::thread>                        m_workers;
+
+    public:
+        explicit ThreadPool(size_t threadCount = std::thread::hardware_concurrency()) {
+
+            // Queue 0 belongs to the threads calling parallelFor(), the others to the workers
+            threadCount = std::max<size_t>(threadCount, 1);
+            for (size_t i = 0; i <= threadCount; ++i) {
+                m_queues.emplace_back(std::make_unique<Queue>());
+            }
+            for (size_t i = 1; i <= threadCount; ++i) {
+                m_workers.emplace_back([this, i] { work(i); });
+            }
+        }
+
+        ~ThreadPool() {
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_condition.notify_all();
+            for (auto& worker : m_workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        template<typename F>
+        auto submit(F&& function) -> std::future<decltype(function())> {
+
+            using Result = decltype(function());
+
+            // std::function needs a copyable callable, so the packaged task is shared
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+            auto future = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.emplace([task] { (*task)(); });
+                m_pending.fetch_add(1, std::memory_order_release);
+            }
+            m_condition.notify_one();
+            return future;
+        }
+
+        // Run function(chunkBegin, chunkEnd) over [begin, end) in chunks of <grain>, returns once every chunk is done
+        // The calling thread works on the loop as well, exceptions of a chunk are rethrown
+        template<typename F>
+        void parallelFor(size_t begin, size_t end, size_t grain, F&& function) {
+
+            if (begin >= end) return;
+            grain = std::max<size_t>(grain, 1);
+            size_t chunkCount = (end - begin + grain - 1) / grain;
+
+            // A single chunk is not worth waking anyone
+            if (chunkCount == 1) {
+                function(begin, end);
+                return;
+            }
+
+            std::atomic<size_t> remaining { chunkCount };
+            std::exception_ptr exception;
+            std::mutex exceptionMutex;
+
+            // Chunks are counted before they are published, so that taking one never finds the count at zero
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_pending.fetch_add(chunkCount, std::memory_order_release);
+            }
+
+            // Chunks are dealt round-robin, neighbouring chunks start on different threads
+            for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+                size_t chunkBegin = begin + chunk * grain;
+                size_t chunkEnd = std::min(end, chunkBegin + grain);
+                auto& queue = *m_queues[chunk % m_queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.tasks.emplace_back([&function, &remaining, &exception, &exceptionMutex, chunkBegin, chunkEnd] {
+                    try {
+                        function(chunkBegin, chunkEnd);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(exceptionMutex);
+                        if (!exception) exception = std::current_exception();
+                    }
+                    remaining.fetch_sub(1, std::memory_order_acq_rel);
+                });
+            }
+            m_condition.notify_all();
+
+            // Work on the loop, chunks taken by workers may still be running once no chunk is left to take
+            while (remaining.load(std::memory_order_acquire)) {
+                if (!runChunk(0)) std::this_thread::yield();
+            }
+            if (exception) std::rethrow_exception(exception);
+        }
+
+        [[nodiscard]] size_t size() const { return m_workers.size(); }
+
+    private:
+        // Run one chunk of a loop: the back of the own queue first, then the front of the others
+        bool runChunk(size_t self) {
+
+            std::function<void()> task;
+            for (size_t i = 0; i < m_queues.size() && !task; ++i) {
+                auto& queue = *m_queues[(self + i) % m_queues.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.tasks.empty()) continue;
+                if (i == 0) {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                } else {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+            }
+            if (!task) return false;
+
+            m_pending.fetch_sub(1, std::memory_order_acq_rel);
+            task();
+            return true;
+        }
+
+        // Run the oldest submitted task
+        bool runTask() {
+
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_tasks.empty()) return false;
+                task = std::move(m_tasks.front());
+                m_tasks.pop();
+            }
+
+            m_pending.fetch_sub(1, std::memory_order_acq_rel);
+            task();
+            return true;
+        }
+
+        void work(size_t self) {
+
+            while (true) {
+                if (runChunk(self) || runTask()) continue;
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this] { return m_stopping || m_pending.load(std::memory_order_acquire) > 0; });
+                if (m_stopping && !m_pending.load(std::memory_order_acquire)) return;
+            }
+        }
+    };
+}
+
+#endif //HYDROCOREPLAYER_THREADPOOL_H
@@ -0,0 +1,66 @@
+//
+// Created by Yucheng Soku on 2024/11/28.
+//
+
+#ifndef HYDROCOREPLAYER_TRACE_H
+#define HYDROCOREPLAYER_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+namespace NextHydro {
+
+    // Timeline of host phases and GPU passes in the Chrome trace-event format (chrome://tracing, ui.perfetto.dev)
+    // Every thread appends complete events to its own chunked buffer without locking, flush() streams the events
+    // recorded so far to the trace file and frees their chunks. When tracing is disabled a scope costs one relaxed load.
+    class Trace {
+    private:
+        inline static std::atomic<bool>     s_enabled   { false };
+
+    public:
+        // Start a trace file (a running trace is finished first), stop finishes the file
+        // start returns the session of the trace, stopping a session does nothing once another trace was started
+        static uint64_t start(const std::string& path);
+        static void     stop();
+        static void     stop(uint64_t session);
+        static void     flush();
+
+        [[nodiscard]] static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+        // Host time in nanoseconds of the steady clock (CLOCK_MONOTONIC on Linux), GPU events are converted into it
+        [[nodiscard]] static uint64_t now() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        // Complete events of the calling thread and of the GPU queue (names are truncated to 63 characters)
+        static void     host(const char* name, uint64_t beginNs, uint64_t endNs);
+        static void     device(const std::string& name, uint64_t beginNs, uint64_t endNs);
+    };
+
+    // Host phase lasting until the end of the enclosing scope
+    class TraceScope {
+    private:
+        const char*     m_name;
+        uint64_t        m_begin     = 0;
+
+    public:
+        explicit TraceScope(const char* name) : m_name(name) {
+            if (Trace::enabled()) m_begin = Trace::now();
+        }
+
+        ~TraceScope() {
+            if (m_begin) Trace::host(m_name, m_begin, Trace::now());
+        }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+    };
+}
+
+#define HYDRO_TRACE_CONCAT_(a, b) a##b
+#define HYDRO_TRACE_CONCAT(a, b) HYDRO_TRACE_CONCAT_(a, b)
+#define HYDRO_TRACE_SCOPE(name) NextHydro::TraceScope HYDRO_TRACE_CONCAT(traceScope, __LINE__)(name)
+
+#endif //HYDROCOREPLAYER_TRACE_H
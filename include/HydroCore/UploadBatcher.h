@@ -0,0 +1,61 @@
+//
+// Created by Yucheng Soku on 2024/11/25.
+//
+
+#ifndef HYDROCOREPLAYER_UPLOADBATCHER_H
+#define HYDROCOREPLAYER_UPLOADBATCHER_H
+
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "Buffer.h"
+#include "Allocator.h"
+
+namespace NextHydro {
+
+    // Batcher of resource uploads
+    // Data of buffers in memory both DEVICE_LOCAL and HOST_VISIBLE is written directly. Other data is packed into one
+    // staging ring and all copies (and fills) are recorded into one command buffer, which is submitted once by flush().
+    // When the ring is full, pending commands are flushed and the ring is rewound.
+    class UploadBatcher {
+    private:
+        // Copy from the ring, or fill with a 32-bit pattern if <fill> is set
+        struct PendingCommand {
+            VkBuffer                dstBuffer;
+            VkBufferCopy            region;
+            bool                    fill;
+            uint32_t                pattern;
+        };
+
+        const VkDevice&                 m_device;
+        Allocator&                      m_allocator;
+        VkCommandPool                   m_commandPool;
+        VkQueue                         m_queue;
+        VkDeviceSize                    m_ringSize;
+        VkDeviceSize                    m_ringHead          = 0;
+        std::unique_ptr<Buffer>         m_ring;
+        std::vector<PendingCommand>     m_pendingCommands;
+
+    public:
+        UploadBatcher(const VkDevice& device, Allocator& allocator, VkCommandPool commandPool, VkQueue queue, VkDeviceSize ringSize = 64 * 1024 * 1024);
+        ~UploadBatcher();
+
+        UploadBatcher(const UploadBatcher&) = delete;
+        UploadBatcher& operator=(const UploadBatcher&) = delete;
+
+        void upload(Buffer* dstBuffer, const char* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+        // Initialise buffer on the device without any host data (offset and size are multiples of 4)
+        void fill(Buffer* dstBuffer, uint32_t pattern, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize dstOffset = 0);
+
+        // Submit all pending copies and wait for them
+        void flush();
+
+        [[nodiscard]] bool empty() const { return m_pendingCommands.empty(); }
+
+    private:
+        static bool writable(const Buffer* buffer);
+    };
+}
+
+#endif //HYDROCOREPLAYER_UPLOADBATCHER_H
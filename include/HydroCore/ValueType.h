@@ -6,7 +6,10 @@
 #define HYDROCOREPLAYER_VALUETYPE_H
 
 #include <array>
+#include <cstring>
+#include <cstdint>
 #include <iostream>
+#include <algorithm>
 #include "nlohmann/json.hpp"
 
 using Json = nlohmann::json;
@@ -157,6 +160,74 @@ namespace NextHydro {
         }
     };
 
+    // Packed value types
+    // Elements are packed into 32-bit words (the first element in the lowest bits) whatever the packing of the block is,
+    // shaders declare the storage as uint[] and unpack elements with the helpers of "hydrocore/packing.glsl".
+    class F16 {
+    public:
+        static size_t bits() {
+            return 16;
+        }
+
+        static uint32_t encode(const Json& value) {
+            return floatToHalf(value.get<float>());
+        }
+
+        // IEEE 754 binary16 with round to nearest even (the conversion of packHalf2x16)
+        static uint32_t floatToHalf(float value) {
+
+            uint32_t x;
+            std::memcpy(&x, &value, sizeof(float));
+            uint32_t sign = (x >> 16) & 0x8000u;
+            uint32_t exponent = (x >> 23) & 0xffu;
+            uint32_t mantissa = x & 0x7fffffu;
+            if (exponent == 0xffu) return sign | 0x7c00u | (mantissa ? 0x200u : 0u);
+
+            int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+            if (halfExponent >= 0x1f) return sign | 0x7c00u;
+
+            // Subnormal halves keep the implicit bit in the mantissa
+            if (halfExponent <= 0) {
+                if (halfExponent < -10) return sign;
+                mantissa |= 0x800000u;
+                uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+                uint32_t half = mantissa >> shift;
+                uint32_t rest = mantissa & ((1u << shift) - 1u);
+                uint32_t halfway = 1u << (shift - 1u);
+                if (rest > halfway || (rest == halfway && (half & 1u))) ++half;
+                return sign | half;
+            }
+
+            // A carry out of the mantissa rounds up the exponent (up to infinity)
+            uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+            uint32_t rest = mantissa & 0x1fffu;
+            if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) ++half;
+            return sign | half;
+        }
+    };
+
+    class U8 {
+    public:
+        static size_t bits() {
+            return 8;
+        }
+
+        static uint32_t encode(const Json& value) {
+            return static_cast<uint32_t>(std::clamp<int64_t>(value.get<int64_t>(), 0, 255));
+        }
+    };
+
+    class Mask {
+    public:
+        static size_t bits() {
+            return 1;
+        }
+
+        static uint32_t encode(const Json& value) {
+            return (value.is_boolean() ? value.get<bool>() : value.get<double>() != 0.0) ? 1u : 0u;
+        }
+    };
+
     class Vec2 {
     public:
         float x, y;
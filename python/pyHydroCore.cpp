@@ -4,15 +4,43 @@
 
 #include <pybind11/pybind11.h>
 #include "HydroCore/Core.h"
+#include "HydroCore/Cluster.h"
 #include "pybind11/stl.h"
 
 namespace py = pybind11;
 
 void register_core(py::module & m) {
+    py::class_<NextHydro::PassStatistics>(m, "PassStatistics")
+            .def_readonly("pass_", &NextHydro::PassStatistics::pass)
+            .def_readonly("count", &NextHydro::PassStatistics::count)
+            .def_readonly("meanMs", &NextHydro::PassStatistics::meanMs)
+            .def_readonly("p50Ms", &NextHydro::PassStatistics::p50Ms)
+            .def_readonly("p99Ms", &NextHydro::PassStatistics::p99Ms)
+            .def_readonly("totalMs", &NextHydro::PassStatistics::totalMs)
+            .def_readonly("invocations", &NextHydro::PassStatistics::invocations);
+
     py::class_<NextHydro::Core>(m, "Core")
-            .def(py::init<>())
-            .def("initialization", &NextHydro::Core::initialization)
-            .def("step", &NextHydro::Core::step);
+            .def(py::init<int32_t>(), py::arg("deviceIndex") = -1)
+            .def_readonly_static("hostDevice", &NextHydro::Core::hostDevice)
+            .def("initialization", py::overload_cast<const std::string&>(&NextHydro::Core::initialization))
+            .def("step", &NextHydro::Core::step)
+            .def("stepBatch", &NextHydro::Core::stepBatch)
+            .def("setFramesInFlight", &NextHydro::Core::setFramesInFlight)
+            .def("setPollInterval", &NextHydro::Core::setPollInterval)
+            .def_static("setShaderCacheDirectory", &NextHydro::Core::setShaderCacheDirectory)
+            .def("setAutotune", &NextHydro::Core::setAutotune, py::arg("enabled"), py::arg("repetitions") = 10)
+            .def("setTuningDatabase", &NextHydro::Core::setTuningDatabase)
+            .def("setProfiling", &NextHydro::Core::setProfiling, py::arg("enabled"), py::arg("pipelineStatistics") = false)
+            .def("profile", &NextHydro::Core::profile)
+            .def("setTracing", &NextHydro::Core::setTracing)
+            .def("flushTrace", &NextHydro::Core::flushTrace)
+            .def("reportMemory", &NextHydro::Core::reportMemory)
+            .def("savePipelineCache", &NextHydro::Core::savePipelineCache);
+
+    py::class_<NextHydro::Cluster>(m, "Cluster")
+            .def(py::init<const std::vector<int32_t>&>(), py::arg("deviceIndices"))
+            .def("initialization", &NextHydro::Cluster::initialization)
+            .def("step", &NextHydro::Cluster::step);
 }
 
 PYBIND11_MODULE(pyHydroCore, m) {
@@ -0,0 +1,255 @@
+//
+// Created by Yucheng Soku on 2024/11/24.
+//
+
+#include <string>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include "HydroCore/Allocator.h"
+
+namespace NextHydro {
+
+    // Helpers ////////////////////////////////////////////////////////////////////////////////////////////////////
+    VkDeviceSize align_up(VkDeviceSize offset, VkDeviceSize alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    // Allocator ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    Allocator::Allocator(const VkDevice& device, const VkPhysicalDevice& physicalDevice, VkDeviceSize blockSize)
+            : m_device(device), m_blockSize(blockSize)
+    {
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+        m_limits = deviceProperties.limits;
+        m_blocks.resize(m_memoryProperties.memoryTypeCount);
+        m_transientBlocks.resize(m_memoryProperties.memoryTypeCount);
+    }
+
+    Allocator::~Allocator() {
+
+        for (auto& blocks : m_blocks) {
+            for (auto& block : blocks) {
+                destroyBlock(block);
+            }
+        }
+        for (auto& block : m_transientBlocks) {
+            destroyBlock(block);
+        }
+    }
+
+    uint32_t Allocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties) const {
+
+        for (auto required : { properties | preferredProperties, properties }) {
+            for (uint32_t index = 0; index < m_memoryProperties.memoryTypeCount; ++index) {
+                if ((typeFilter & (1 << index)) && (m_memoryProperties.memoryTypes[index].propertyFlags & required) == required) {
+                    return index;
+                }
+            }
+        }
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    Allocation Allocator::allocate(const VkMemoryRequirements& requirements, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties, bool transient) {
+
+        Allocation allocation {};
+        allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties, preferredProperties);
+        allocation.memoryFlags = m_memoryProperties.memoryTypes[allocation.memoryType].propertyFlags;
+
+        VkDeviceSize alignment = alignmentOf(requirements, usage, allocation.memoryType);
+        allocation.size = align_up(requirements.size, alignment);
+
+        // Transient allocations are bumped from the linear block, which is rewound when it holds no live allocation
+        if (transient) {
+            auto& block = m_transientBlocks[allocation.memoryType];
+            if (block.memory != VK_NULL_HANDLE && block.allocationCount == 0) block.head = 0;
+            if (block.memory != VK_NULL_HANDLE && block.allocationCount == 0 && allocation.size > block.size) destroyBlock(block);
+            if (block.memory == VK_NULL_HANDLE) block = createBlock(allocation.memoryType, std::max(m_blockSize, allocation.size));
+
+            VkDeviceSize offset = align_up(block.head, alignment);
+            if (offset + allocation.size <= block.size) {
+                block.head = offset + allocation.size;
+                block.usedSize += allocation.size;
+                block.allocationCount++;
+
+                allocation.memory = block.memory;
+                allocation.offset = offset;
+                allocation.blockSize = block.size;
+                allocation.transient = true;
+                allocation.mappedData = block.mappedData ? static_cast<char*>(block.mappedData) + offset : nullptr;
+                return allocation;
+            }
+            // Linear block is still in use, fall back to a regular allocation
+        }
+
+        // First fit in the existing blocks, a new block (dedicated for large resources) otherwise
+        auto& blocks = m_blocks[allocation.memoryType];
+        VkDeviceSize offset = 0;
+        size_t blockIndex = 0;
+        for (; blockIndex < blocks.size(); ++blockIndex) {
+            if (allocateFromBlock(blocks[blockIndex], allocation.size, alignment, offset)) break;
+        }
+        if (blockIndex == blocks.size()) {
+            blocks.emplace_back(createBlock(allocation.memoryType, std::max(m_blockSize, allocation.size)));
+            allocateFromBlock(blocks.back(), allocation.size, alignment, offset);
+        }
+
+        auto& block = blocks[blockIndex];
+        block.usedSize += allocation.size;
+        block.allocationCount++;
+
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.blockSize = block.size;
+        allocation.blockIndex = blockIndex;
+        allocation.mappedData = block.mappedData ? static_cast<char*>(block.mappedData) + offset : nullptr;
+        return allocation;
+    }
+
+    void Allocator::free(const Allocation& allocation) {
+
+        if (allocation.memory == VK_NULL_HANDLE) return;
+
+        if (allocation.transient) {
+            auto& block = m_transientBlocks[allocation.memoryType];
+            block.usedSize -= allocation.size;
+            block.allocationCount--;
+            return;
+        }
+
+        auto& block = m_blocks[allocation.memoryType][allocation.blockIndex];
+        block.usedSize -= allocation.size;
+        block.allocationCount--;
+
+        // Return the range and merge it with its free neighbours
+        auto it = block.freeRanges.emplace(allocation.offset, allocation.size).first;
+        auto next = std::next(it);
+        if (next != block.freeRanges.end() && it->first + it->second == next->first) {
+            it->second += next->second;
+            block.freeRanges.erase(next);
+        }
+        if (it != block.freeRanges.begin()) {
+            auto prev = std::prev(it);
+            if (prev->first + prev->second == it->first) {
+                prev->second += it->second;
+                block.freeRanges.erase(it);
+            }
+        }
+    }
+
+    MemoryStatistics Allocator::statistics(uint32_t memoryType) const {
+
+        MemoryStatistics statistics {};
+        for (const auto& block : m_blocks[memoryType]) {
+            statistics.allocatedSize += block.size;
+            statistics.usedSize += block.usedSize;
+            statistics.allocationCount += block.allocationCount;
+            statistics.blockCount++;
+            for (const auto& range : block.freeRanges) {
+                statistics.largestFreeRange = std::max(statistics.largestFreeRange, range.second);
+                statistics.freeRangeCount++;
+            }
+        }
+        const auto& transientBlock = m_transientBlocks[memoryType];
+        if (transientBlock.memory != VK_NULL_HANDLE) {
+            statistics.allocatedSize += transientBlock.size;
+            statistics.usedSize += transientBlock.usedSize;
+            statistics.allocationCount += transientBlock.allocationCount;
+            statistics.blockCount++;
+        }
+        return statistics;
+    }
+
+    void Allocator::report(std::ostream& os) const {
+
+        os << "==================== Device Memory ====================" << std::endl;
+        os << "Device allocations: " << m_deviceAllocationCount << " / " << m_limits.maxMemoryAllocationCount << std::endl;
+        for (uint32_t type = 0; type < m_memoryProperties.memoryTypeCount; ++type) {
+            auto typeStatistics = statistics(type);
+            if (!typeStatistics.blockCount) continue;
+
+            double utilisation = typeStatistics.allocatedSize ? 100.0 * static_cast<double>(typeStatistics.usedSize) / static_cast<double>(typeStatistics.allocatedSize) : 0.0;
+            os << "Memory type " << type << " (flags " << m_memoryProperties.memoryTypes[type].propertyFlags << "): "
+               << typeStatistics.blockCount << " blocks, "
+               << typeStatistics.allocatedSize / 1024 << " KiB allocated, "
+               << typeStatistics.usedSize / 1024 << " KiB used ("
+               << std::fixed << std::setprecision(1) << utilisation << "%), "
+               << typeStatistics.allocationCount << " allocations" << std::endl;
+        }
+    }
+
+    Allocator::MemoryBlock Allocator::createBlock(uint32_t memoryType, VkDeviceSize size) {
+
+        if (m_deviceAllocationCount >= m_limits.maxMemoryAllocationCount) {
+            throw std::runtime_error("maxMemoryAllocationCount of device is reached!");
+        }
+
+        MemoryBlock block {};
+        block.size = size;
+        block.freeRanges.emplace(0, size);
+
+        VkMemoryAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.memoryTypeIndex = memoryType;
+        allocInfo.allocationSize = size;
+        if (vkAllocateMemory(m_device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate memory block of " + std::to_string(size) + " bytes!");
+        }
+        m_deviceAllocationCount++;
+
+        // Persistent mapping of host visible blocks
+        if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            if (vkMapMemory(m_device, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mappedData) != VK_SUCCESS) {
+                throw std::runtime_error("failed to map memory!");
+            }
+        }
+        return block;
+    }
+
+    void Allocator::destroyBlock(MemoryBlock& block) {
+
+        if (block.memory == VK_NULL_HANDLE) return;
+
+        // Freeing memory unmaps it implicitly
+        vkFreeMemory(m_device, block.memory, nullptr);
+        m_deviceAllocationCount--;
+        block = MemoryBlock {};
+    }
+
+    VkDeviceSize Allocator::alignmentOf(const VkMemoryRequirements& requirements, VkBufferUsageFlags usage, uint32_t memoryType) const {
+
+        // All alignments are powers of two, so the largest one satisfies all of them
+        VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+        if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) alignment = std::max(alignment, m_limits.minStorageBufferOffsetAlignment);
+        if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) alignment = std::max(alignment, m_limits.minUniformBufferOffsetAlignment);
+
+        // Flushed and invalidated ranges of non-coherent memory must not overlap other allocations
+        auto flags = m_memoryProperties.memoryTypes[memoryType].propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+            alignment = std::max(alignment, m_limits.nonCoherentAtomSize);
+        }
+        return alignment;
+    }
+
+    bool Allocator::allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+
+        for (auto it = block.freeRanges.begin(); it != block.freeRanges.end(); ++it) {
+            VkDeviceSize rangeBegin = it->first;
+            VkDeviceSize rangeEnd = it->first + it->second;
+            VkDeviceSize alignedBegin = align_up(rangeBegin, alignment);
+            if (alignedBegin + size > rangeEnd) continue;
+
+            // Split the free range, padding in front of the allocation stays free
+            block.freeRanges.erase(it);
+            if (alignedBegin > rangeBegin) block.freeRanges.emplace(rangeBegin, alignedBegin - rangeBegin);
+            if (alignedBegin + size < rangeEnd) block.freeRanges.emplace(alignedBegin + size, rangeEnd - alignedBegin - size);
+
+            offset = alignedBegin;
+            return true;
+        }
+        return false;
+    }
+}
@@ -12,11 +12,16 @@ namespace NextHydro {
         return (offset + alignment - 1) & ~(alignment - 1);
     }
 
+    bool is_packed(const std::string& typeName) {
+        return rttr::type::get_by_name(typeName).get_method("bits").is_valid();
+    }
+
     size_t calculate_dynamic_size(const std::vector<std::string>& typeList) {
         size_t offset = 0;
 
         for (const auto& typeName : typeList) {
 
+            if (is_packed(typeName)) throw std::runtime_error("packed type " + typeName + " can not be part of a block layout.");
             auto type = rttr::type::get_by_name(typeName);
             size_t typeSize = type.get_method("size").invoke({}).get_value<size_t>();
             size_t typeAlignment = type.get_method("alignment").invoke({}).get_value<size_t>();
@@ -27,9 +32,29 @@ namespace NextHydro {
         return offset;
     }
 
+    size_t calculate_dynamic_alignment(const std::vector<std::string>& typeList) {
+        size_t alignment = 1;
+
+        for (const auto& typeName : typeList) {
+
+            auto type = rttr::type::get_by_name(typeName);
+            alignment = std::max(alignment, type.get_method("alignment").invoke({}).get_value<size_t>());
+        }
+        return alignment;
+    }
+
+    Packing parsePacking(const std::string& packing) {
+
+        if (packing == "std140") return Packing::Std140;
+        if (packing == "std430") return Packing::Std430;
+        throw std::runtime_error("unknown packing \"" + packing + "\", expected std140 or std430.");
+    }
+
     // Block ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    Block::Block(const Json &typeList, const Json &jsonData) {
+    Block::Block(const Json &typeList, const Json &jsonData, Packing packing)
+            : packing(packing)
+    {
 
         bool needFilling = jsonData.is_array();
         uint32_t typeListLength = typeList.is_array() ? typeList.size() : 1;
@@ -38,53 +63,90 @@ namespace NextHydro {
         // Check if jsonData is suitable for block size
         assert(dataLength % typeListLength == 0);
 
-        // Allocate memory for buffer
-        size = 0;
+        // Packed types fill 32-bit words whatever the packing is
+        if (!typeList.is_array() && is_packed(typeList.get<std::string>())) {
+            auto type = rttr::type::get_by_name(typeList.get<std::string>());
+            auto encode = type.get_method("encode");
+            size_t bits = type.get_method("bits").invoke({}).get_value<size_t>();
+            size_t elementsPerWord = 32 / bits;
+            uint32_t elementMask = (1u << bits) - 1u;
+
+            stride = sizeof(uint32_t);
+            size = std::max<size_t>((dataLength + elementsPerWord - 1) / elementsPerWord, 1) * sizeof(uint32_t);
+
+            // Fill value repeated for every element of a word
+            if (!needFilling) {
+                if (jsonData.contains("fill")) {
+                    uint32_t element = encode.invoke({}, jsonData["fill"]).get_value<uint32_t>() & elementMask;
+                    for (size_t i = 0; i < elementsPerWord; ++i) fillPattern |= element << (i * bits);
+                }
+                return;
+            }
+
+            buffer = std::make_unique<char[]>(size);
+            std::memset(buffer.get(), 0, size);
+            auto words = reinterpret_cast<uint32_t*>(buffer.get());
+            for (size_t i = 0; i < dataLength; ++i) {
+                uint32_t element = encode.invoke({}, jsonData[i]).get_value<uint32_t>() & elementMask;
+                words[i / elementsPerWord] |= element << ((i % elementsPerWord) * bits);
+            }
+            return;
+        }
+
+        // Calculate array stride of blocks
         size_t sizePerBlock;
+        size_t alignmentPerBlock;
         if (typeList.is_array()) {
             sizePerBlock = calculate_dynamic_size(typeList);
+            alignmentPerBlock = calculate_dynamic_alignment(typeList);
         } else {
             auto type = rttr::type::get_by_name(typeList);
             sizePerBlock = type.get_method("size").invoke({}).get_value<size_t>();
+            alignmentPerBlock = type.get_method("alignment").invoke({}).get_value<size_t>();
         }
+        if (packing == Packing::Std140) alignmentPerBlock = align_to(alignmentPerBlock, 16);
+        stride = align_to(sizePerBlock, alignmentPerBlock);
+
         size_t blockCount = dataLength / typeListLength;
-        for (size_t i = 0; i < blockCount; ++i) {
-            size += sizePerBlock;
-            size = align_to(size, 16);
+        size = stride * blockCount;
+
+        // Length-only resources are filled on the device
+        if (!needFilling) {
+            if (jsonData.contains("fill")) {
+                Flag fill {};
+                if (!typeList.is_array() && typeList.get<std::string>() == "U32") fill.u = jsonData["fill"].get<uint32_t>();
+                else fill.f = jsonData["fill"].get<float>();
+                fillPattern = fill.u;
+            }
+            return;
         }
-        buffer = std::make_unique<char[]>(size);
 
-        // Need to be filled or not
-        if (!needFilling) return;
+        // Allocate memory for buffer
+        buffer = std::make_unique<char[]>(size);
 
         // Fill data
-        size_t index =0;
-        size_t offset = 0;
+        size_t index = 0;
+        size_t blockOffset = 0;
+        std::vector<std::string> typeNames;
         if (typeList.is_array()) {
-            while(index < dataLength) {
-                for (const auto& typeName: typeList) {
-                    auto type = rttr::type::get_by_name(typeName);
-                    size_t typeSize = type.get_method("size").invoke({}).get_value<size_t>();
-                    size_t typeAlignment = type.get_method("alignment").invoke({}).get_value<size_t>();
-                    auto data = type.get_method("getBufferFromJson").invoke({}, jsonData, index).get_value<std::vector<char>>();
-
-                    offset = align_to(offset, typeAlignment);
-
-                    std::memcpy(buffer.get() + offset, data.data(), typeSize);
-                    offset += typeSize;
-                }
-                offset = align_to(offset, 16);
-            }
+            typeNames = typeList.get<std::vector<std::string>>();
         } else {
-            while(index < dataLength) {
-                auto type = rttr::type::get_by_name(typeList);
+            typeNames = { typeList.get<std::string>() };
+        }
+        while(index < dataLength) {
+            size_t offset = blockOffset;
+            for (const auto& typeName: typeNames) {
+                auto type = rttr::type::get_by_name(typeName);
                 size_t typeSize = type.get_method("size").invoke({}).get_value<size_t>();
                 size_t typeAlignment = type.get_method("alignment").invoke({}).get_value<size_t>();
                 auto data = type.get_method("getBufferFromJson").invoke({}, jsonData, index).get_value<std::vector<char>>();
+
                 offset = align_to(offset, typeAlignment);
+
                 std::memcpy(buffer.get() + offset, data.data(), typeSize);
                 offset += typeSize;
             }
+            blockOffset += stride;
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,286 @@
+//
+// Created by Yucheng Soku on 2024/11/29.
+//
+
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include "HydroCore/Trace.h"
+#include "HydroCore/Cluster.h"
+
+namespace NextHydro {
+
+    // Cluster /////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    Cluster::Cluster(const std::vector<int32_t>& deviceIndices) {
+
+        if (deviceIndices.empty()) throw std::runtime_error("cluster needs at least one device!");
+
+        strips.resize(deviceIndices.size());
+        for (size_t i = 0; i < deviceIndices.size(); ++i) {
+            strips[i].core = std::make_unique<Core>(deviceIndices[i]);
+
+            // Halos are exchanged through Vulkan buffers, a core without a device runs the script on the CPU backend
+            if (strips[i].core->cpuBackend) {
+                throw std::runtime_error("cluster needs a Vulkan device for every strip, strip " + std::to_string(i) + " has none!");
+            }
+        }
+        m_pool = std::make_unique<ThreadPool>(strips.size());
+    }
+
+    Cluster::~Cluster() {
+
+        // Staging buffers belong to the device of their core
+        for (auto& strip : strips) {
+            if (strip.staging) strip.staging->release();
+        }
+    }
+
+    void Cluster::initialization(const std::string& path) {
+        HYDRO_TRACE_SCOPE("clusterInitialization");
+
+        std::ifstream f(path);
+        if (!f) throw std::runtime_error("failed to open JSON file: " + path);
+        Json script = Json::parse(f);
+
+        if (!script.contains("decomposition")) throw std::runtime_error("script has no decomposition block!");
+        const auto& decomposition = script["decomposition"];
+        m_rows = decomposition["rows"].get<uint32_t>();
+        m_rowLength = decomposition["rowLength"].get<uint32_t>();
+        m_halo = decomposition.value("halo", 1u);
+        m_exchangeNames = decomposition.value("exchange", std::vector<std::string>{});
+        m_reduceStorage = decomposition["reduce"]["storage"].get<std::string>();
+        m_reduceIndex = decomposition["reduce"]["index"].get<uint32_t>();
+        m_reduceOperation = decomposition["reduce"].value("operation", std::string("min"));
+
+        if (m_reduceOperation != "min" && m_reduceOperation != "max") {
+            throw std::runtime_error("reduction operation <" + m_reduceOperation + "> is not supported by clusters!");
+        }
+        if (m_rows < strips.size() * std::max<uint32_t>(m_halo, 1)) {
+            throw std::runtime_error("grid of " + std::to_string(m_rows) + " rows is too small for " + std::to_string(strips.size()) + " strips!");
+        }
+
+        // Rows of a packed storage do not start at word boundaries
+        for (const auto& storageInfo : script["storages"]) {
+            std::string name = storageInfo["name"];
+            std::string previous = storageInfo.value("previous", name + "_prev");
+            bool exchanged = std::any_of(m_exchangeNames.begin(), m_exchangeNames.end(), [&](const std::string& exchangeName) {
+                return exchangeName == name || (storageInfo.value("doubleBuffered", false) && exchangeName == previous);
+            });
+            const auto& layout = storageInfo["layout"];
+            if (exchanged && layout.is_string() && (layout == "F16" || layout == "U8" || layout == "Mask")) {
+                throw std::runtime_error("packed storage <" + name + "> can not be exchanged between strips!");
+            }
+        }
+
+        // Owned rows are split evenly, each strip also holds <halo> ghost rows of every neighbour
+        auto stripCount = static_cast<uint32_t>(strips.size());
+        for (uint32_t i = 0; i < stripCount; ++i) {
+            auto& strip = strips[i];
+            strip.ownedBegin = static_cast<uint32_t>(uint64_t(m_rows) * i / stripCount);
+            strip.ownedEnd = static_cast<uint32_t>(uint64_t(m_rows) * (i + 1) / stripCount);
+            strip.rowOffset = strip.ownedBegin > m_halo ? strip.ownedBegin - m_halo : 0;
+            strip.rowCount = std::min(m_rows, strip.ownedEnd + m_halo) - strip.rowOffset;
+
+            strip.core->initialization(stripScript(script, strip));
+
+            // Halos are exchanged after every step, so every step has to be complete when step() returns
+            // (strips still overlap, each of them waits for its own device on its own thread)
+            strip.core->setPollInterval(1);
+        }
+    }
+
+    Json Cluster::stripScript(const Json& script, const Strip& strip) const {
+
+        Json stripped = script;
+        uint64_t gridCells = uint64_t(m_rows) * m_rowLength;
+        uint64_t stripCells = uint64_t(strip.rowCount) * m_rowLength;
+        uint64_t firstCell = uint64_t(strip.rowOffset) * m_rowLength;
+
+        // Storages holding the grid are cut to the rows of the strip
+        for (auto& storageInfo : stripped["storages"]) {
+            auto& resource = storageInfo["resource"];
+            uint64_t cellSize = storageInfo["layout"].is_array() ? storageInfo["layout"].size() : 1;
+
+            if (resource.is_array()) {
+                if (resource.size() != gridCells * cellSize) continue;
+                resource = Json(resource.begin() + static_cast<ptrdiff_t>(firstCell * cellSize),
+                                resource.begin() + static_cast<ptrdiff_t>((firstCell + stripCells) * cellSize));
+            } else if (resource["length"].get<uint64_t>() == gridCells * cellSize) {
+                resource["length"] = stripCells * cellSize;
+            }
+        }
+
+        // Rows of the strip, written into the uniform read by the shaders
+        const auto& stripInfo = script["decomposition"]["strip"];
+        std::string uniformName = stripInfo["uniform"];
+        auto index = stripInfo["index"].get<size_t>();
+        bool found = false;
+        for (auto& uniformInfo : stripped["uniforms"]) {
+            if (uniformInfo["name"] != uniformName) continue;
+            auto& resource = uniformInfo["resource"];
+            if (!resource.is_array() || resource.size() < index + 4) {
+                throw std::runtime_error("uniform <" + uniformName + "> has no room for the rows of a strip!");
+            }
+            resource[index + 0] = strip.rowOffset;
+            resource[index + 1] = strip.rowCount;
+            resource[index + 2] = strip.ownedBegin;
+            resource[index + 3] = strip.ownedEnd;
+            found = true;
+        }
+        if (!found) throw std::runtime_error("uniform <" + uniformName + "> does not exist!");
+
+        // Passes over all rows dispatch over the rows of the strip
+        for (auto& passInfo : stripped["passes"]) {
+            if (passInfo.contains("computeScale") && passInfo["computeScale"][1].get<uint32_t>() == m_rows) {
+                passInfo["computeScale"][1] = strip.rowCount;
+            }
+        }
+
+        stripped.erase("decomposition");
+        return stripped;
+    }
+
+    bool Cluster::step() {
+        HYDRO_TRACE_SCOPE("clusterStep");
+
+        // Every strip submits its step and waits for it on a thread of the pool, so that all devices run at once
+        std::vector<std::future<bool>> steps;
+        for (auto& strip : strips) {
+            steps.emplace_back(m_pool->submit([&strip] { return strip.core->step(); }));
+        }
+
+        // All steps are finished before an error is reported, none of them may still use its strip
+        bool running = false;
+        std::exception_ptr error;
+        for (auto& step : steps) {
+            try {
+                running |= step.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+
+        exchangeHalos();
+        combineReduction();
+        return running;
+    }
+
+    void Cluster::exchangeHalos() {
+        HYDRO_TRACE_SCOPE("exchangeHalos");
+
+        std::vector<char> rows;
+        for (size_t i = 0; i + 1 < strips.size(); ++i) {
+            auto& lower = strips[i];
+            auto& upper = strips[i + 1];
+            auto lowerRows = std::min(m_halo, lower.ownedEnd - lower.ownedBegin);
+            auto upperRows = std::min(m_halo, upper.ownedEnd - upper.ownedBegin);
+
+            for (const auto& name : m_exchangeNames) {
+
+                // Last owned rows of the lower strip are the first ghost rows of the upper strip
+                readRows(lower, name, lower.ownedEnd - lowerRows, lowerRows, rows);
+                writeRows(upper, name, lower.ownedEnd - lowerRows, rows);
+
+                // First owned rows of the upper strip are the last ghost rows of the lower strip
+                readRows(upper, name, upper.ownedBegin, upperRows, rows);
+                writeRows(lower, name, upper.ownedBegin, rows);
+            }
+        }
+    }
+
+    void Cluster::combineReduction() {
+        HYDRO_TRACE_SCOPE("combineReduction");
+
+        if (strips.size() < 2) return;
+
+        std::vector<float> values(strips.size());
+        for (size_t i = 0; i < strips.size(); ++i) {
+            auto buffer = strips[i].core->currentBuffer(m_reduceStorage);
+            if (!buffer) throw std::runtime_error("storage <" + m_reduceStorage + "> does not exist!");
+
+            std::vector<char> data;
+            readBytes(strips[i], buffer, m_reduceIndex * sizeof(float), sizeof(float), data);
+            std::memcpy(&values[i], data.data(), sizeof(float));
+        }
+
+        float combined = m_reduceOperation == "min"
+                         ? *std::min_element(values.begin(), values.end())
+                         : *std::max_element(values.begin(), values.end());
+
+        std::vector<char> data(sizeof(float));
+        std::memcpy(data.data(), &combined, sizeof(float));
+        for (auto& strip : strips) {
+            writeBytes(strip, strip.core->currentBuffer(m_reduceStorage), m_reduceIndex * sizeof(float), data);
+        }
+    }
+
+    void Cluster::readRows(Strip& strip, const std::string& name, uint32_t row, uint32_t count, std::vector<char>& data) {
+
+        auto buffer = strip.core->currentBuffer(name);
+        if (!buffer) throw std::runtime_error("storage <" + name + "> does not exist!");
+
+        VkDeviceSize rowSize = VkDeviceSize(m_rowLength) * strip.core->buffer_stride_map.at(name);
+        readBytes(strip, buffer, (row - strip.rowOffset) * rowSize, count * rowSize, data);
+    }
+
+    void Cluster::writeRows(Strip& strip, const std::string& name, uint32_t row, const std::vector<char>& data) {
+
+        auto buffer = strip.core->currentBuffer(name);
+        if (!buffer) throw std::runtime_error("storage <" + name + "> does not exist!");
+
+        VkDeviceSize rowSize = VkDeviceSize(m_rowLength) * strip.core->buffer_stride_map.at(name);
+        writeBytes(strip, buffer, (row - strip.rowOffset) * rowSize, data);
+    }
+
+    void Cluster::readBytes(Strip& strip, Buffer* buffer, VkDeviceSize offset, VkDeviceSize size, std::vector<char>& data) {
+
+        data.resize(static_cast<size_t>(size));
+        if (!size) return;
+
+        // Host-visible storages are read directly, others through the staging buffer of the strip
+        if (buffer->mappedData) {
+            buffer->invalidate(offset, size);
+            std::memcpy(data.data(), static_cast<char*>(buffer->mappedData) + offset, static_cast<size_t>(size));
+            return;
+        }
+
+        auto staging = stagingOf(strip, size);
+        strip.core->copyBuffer(buffer->buffer, staging->buffer, size, offset, 0);
+        staging->invalidate(0, size);
+        std::memcpy(data.data(), staging->mappedData, static_cast<size_t>(size));
+    }
+
+    void Cluster::writeBytes(Strip& strip, Buffer* buffer, VkDeviceSize offset, const std::vector<char>& data) {
+
+        auto size = static_cast<VkDeviceSize>(data.size());
+        if (!size) return;
+
+        if (buffer->mappedData) {
+            std::memcpy(static_cast<char*>(buffer->mappedData) + offset, data.data(), data.size());
+            buffer->flush(offset, size);
+            return;
+        }
+
+        auto staging = stagingOf(strip, size);
+        std::memcpy(staging->mappedData, data.data(), data.size());
+        staging->flush(0, size);
+        strip.core->copyBuffer(staging->buffer, buffer->buffer, size, 0, offset);
+    }
+
+    Buffer* Cluster::stagingOf(Strip& strip, VkDeviceSize size) {
+
+        // Grown on demand, the largest transfer is <halo> rows of the widest exchanged storage
+        if (!strip.staging || strip.staging->size < size) {
+            if (strip.staging) strip.staging->release();
+
+            Buffer* staging = nullptr;
+            strip.core->createStagingBuffer("Halo Staging Buffer", staging, size);
+            strip.staging.reset(staging);
+        }
+        return strip.staging.get();
+    }
+}
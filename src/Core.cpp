@@ -4,11 +4,17 @@
 #include <set>
 #include <map>
 #include <vector>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <stdexcept>
 #include <vulkan/vulkan.h>
 #include "config.h"
 #include "HydroCore/Core.h"
+#include "HydroCore/BuiltinShaders.h"
+#include "HydroCore/ThreadPool.h"
 #include "nlohmann/json.hpp"
 
 using Json = nlohmann::json;
@@ -30,11 +36,11 @@ namespace NextHydro {
         }
     };
 
-    std::vector<const char*> deviceExtensions = {
+    // Extensions every device has to support, optional ones are enabled per device by createLogicalDevice
+    const std::vector<const char*> deviceExtensions = {
 #ifdef PLATFORM_NEED_PORTABILITY
             "VK_KHR_portability_subset",
 #endif
-            "VK_EXT_shader_atomic_float"
     };
 
     std::vector<char> readFile(const char* filename) {
@@ -162,11 +168,6 @@ namespace NextHydro {
         vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
         std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
         for (const auto& extension: availableExtensions) {
-
-            // Vulkan requires physical devices to support "VK_KHR_portability_subset" if it exists
-            if (extension.extensionName == std::string("VK_KHR_portability_subset")) {
-                deviceExtensions.emplace_back("VK_KHR_portability_subset");
-            }
             requiredExtensions.erase(extension.extensionName);
         }
 
@@ -234,6 +235,17 @@ namespace NextHydro {
         return score;
     }
 
+    std::vector<ResourceAccess> getPipelineAccesses(const ComputePipeline* pipeline, size_t parity = 0) {
+
+        std::vector<ResourceAccess> accesses;
+        const auto& resources = pipeline->bindingResourcesOf(parity);
+        for (size_t i = 0; i < resources.size(); ++i) {
+            if (!resources[i] || !pipeline->bindingResourceAccess[i]) continue;
+            accesses.push_back({ resources[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, pipeline->bindingResourceAccess[i] });
+        }
+        return accesses;
+    }
+
     VkResult CreateDebugUtilsMessengerEXT(
             VkInstance                    instance,
             const                         VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo,
@@ -250,50 +262,83 @@ namespace NextHydro {
     // /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     // Core ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    Core::Core() {
-        createInstance();
-        setupDebugMessenger();
-        pickPhysicalDevice();
+    Core::Core(int32_t deviceIndex) {
+
+        if (deviceIndex == hostDevice) {
+            cpuBackend = std::make_unique<CpuBackend>();
+            return;
+        }
+
+        // Machines without a (suitable) Vulkan device run scripts on the host, unless a device was asked for
+        try {
+            createInstance();
+            setupDebugMessenger();
+            pickPhysicalDevice(deviceIndex);
+        } catch (const NoDeviceError& error) {
+            if (deviceIndex >= 0) throw;
+            std::cerr << error.what() << " Running on the CPU backend." << std::endl;
+            cpuBackend = std::make_unique<CpuBackend>();
+            return;
+        }
         createLogicalDevice();
+        createAllocator();
+        createPipelineCache();
         createCommandPool();
+        createUploader();
+        createSyncObjects();
     }
 
     Core::~Core() {
 
-        // Destruct pipelines
-        for (const auto& pipeline : name_pipeline_map) {
-            auto module = pipeline.second->computeShaderModule->module;
-            if (module != VK_NULL_HANDLE) {
-                vkDestroyShaderModule(device, module, nullptr);
-            }
+        // Only the instance may exist when running on the host
+        if (cpuBackend) {
+            if (traceSession) Trace::stop(traceSession);
+#ifdef ENABLE_VALIDATION_LAYER
+            if (m_debugMessenger != VK_NULL_HANDLE) DestroyDebugUtilsMessengerEXT(instance, m_debugMessenger, nullptr);
+#endif
+            if (instance != VK_NULL_HANDLE) vkDestroyInstance(instance, nullptr);
+            return;
+        }
 
-            for (const auto& layout : pipeline.second->descriptorSetLayout) {
-                if (layout != VK_NULL_HANDLE) {
-                    vkDestroyDescriptorSetLayout(device, layout, nullptr);
-                }
-            }
+        // Frames in flight may still be executing
+        idle();
 
-            if (pipeline.second->pipelineLayout != VK_NULL_HANDLE) {
-                vkDestroyPipelineLayout(device, pipeline.second->pipelineLayout, nullptr);
-            }
+        // Keep driver compiled pipelines for the next run
+        savePipelineCache();
 
-            if (pipeline.second->pipeline != VK_NULL_HANDLE) {
-                vkDestroyPipeline(device, pipeline.second->pipeline, nullptr);
-            }
+        // Finish the trace this core started with the last GPU passes (traces of other cores keep running),
+        // then destruct query pools of the profiler
+        if (profiler) profiler->collect();
+        if (traceSession) Trace::stop(traceSession);
+        profiler.reset();
+
+        // Destruct pipelines
+        for (const auto& pipeline : name_pipeline_map) {
+            destroyPipeline(pipeline.second.get());
         }
 
-        // Destruct buffers
+        // Destruct buffers and their memory blocks
         for (const auto& buffer : name_buffer_map) {
 
-            vkDestroyBuffer(device, buffer.second->buffer, nullptr);
-            vkFreeMemory(device, buffer.second->memory, nullptr);
+            buffer.second->release();
         }
+        for (const auto& aliasAllocation : aliasAllocations) {
+            allocator->free(*aliasAllocation);
+        }
+        uploader.reset();
+        allocator.reset();
 
         // Destruct fences
         for (auto& fence : fences) {
             vkDestroyFence(device, fence, nullptr);
         }
 
+        // Destruct timeline semaphore
+        vkDestroySemaphore(device, timelineSemaphore, nullptr);
+
+        // Destruct pipeline cache
+        vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
         // Destruct command buffer
         vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
 
@@ -350,6 +395,9 @@ namespace NextHydro {
 #endif
 
         VkResult result = vkCreateInstance(&createInfo, nullptr, &instance);
+        if (result == VK_ERROR_INCOMPATIBLE_DRIVER) {
+            throw NoDeviceError("failed to find a Vulkan driver!");
+        }
         if (result != VK_SUCCESS) {
             throw std::runtime_error("failed to create Vulkan instance");
         }
@@ -366,27 +414,43 @@ namespace NextHydro {
 #endif
     }
 
-    void Core::pickPhysicalDevice() {
+    void Core::pickPhysicalDevice(int32_t deviceIndex) {
 
         uint32_t deviceCount = 0;
         vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
         if (deviceCount == 0) {
-            throw std::runtime_error("failed to find GPUs with Vulkan support!");
+            throw NoDeviceError("failed to find GPUs with Vulkan support!");
         }
 
         std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
         vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
 
+        // Requested device
+        if (deviceIndex >= 0) {
+            if (static_cast<uint32_t>(deviceIndex) >= deviceCount) {
+                throw std::runtime_error("GPU " + std::to_string(deviceIndex) + " does not exist (" + std::to_string(deviceCount) + " found)!");
+            }
+            physicalDevice = physicalDevices[deviceIndex];
+            if (rateDeviceSuitability(physicalDevice, maxComputeWorkGroupInvocations, isDiscrete) <= 0) {
+                throw std::runtime_error("GPU " + std::to_string(deviceIndex) + " is not suitable!");
+            }
+            return;
+        }
+
+        // Limits of the scored devices are discarded, only those of the chosen one are kept
         std::multimap<int, VkPhysicalDevice> candidates;
         for (auto pDevice: physicalDevices) {
-            int score = rateDeviceSuitability(pDevice, maxComputeWorkGroupInvocations, isDiscrete);
+            uint32_t invocations = 0;
+            bool discrete = false;
+            int score = rateDeviceSuitability(pDevice, invocations, discrete);
             candidates.insert(std::make_pair(score, pDevice));
         }
 
         if (candidates.rbegin()->first > 0) {
             physicalDevice = candidates.rbegin()->second;
+            rateDeviceSuitability(physicalDevice, maxComputeWorkGroupInvocations, isDiscrete);
         } else {
-            throw std::runtime_error("failed to find suitable GPU!");
+            throw NoDeviceError("failed to find suitable GPU!");
         }
     }
 
@@ -412,31 +476,124 @@ namespace NextHydro {
         VkPhysicalDeviceFeatures deviceFeatures{};
         memset(&deviceFeatures, 0, sizeof(VkPhysicalDeviceFeatures));
 
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+        auto available = [&availableExtensions](const char* name) {
+            return std::any_of(availableExtensions.begin(), availableExtensions.end(), [name](const VkExtensionProperties& extension) {
+                return extension.extensionName == std::string(name);
+            });
+        };
+        // Extensions of this device only: the required ones and the optional ones it supports
+        std::vector<const char*> extensions(deviceExtensions.begin(), deviceExtensions.end());
+        auto enable = [&extensions](const char* name) {
+            if (std::find(extensions.begin(), extensions.end(), std::string(name)) == extensions.end()) extensions.push_back(name);
+        };
+
+        // Vulkan requires "VK_KHR_portability_subset" to be enabled on devices supporting it
+        if (available("VK_KHR_portability_subset")) enable("VK_KHR_portability_subset");
+
+        // Timeline semaphores are core since Vulkan 1.2 and required for frames in flight
+        VkPhysicalDeviceVulkan12Features vulkan12Features {};
+        vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12Features.timelineSemaphore = VK_TRUE;
+
+        // Atomic float is optional, it is only enabled for scripts whose shaders use it
         VkPhysicalDeviceShaderAtomicFloatFeaturesEXT atomicFloatFeatures {};
         atomicFloatFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_FLOAT_FEATURES_EXT;
-        atomicFloatFeatures.shaderBufferFloat32AtomicAdd = VK_TRUE;
-        atomicFloatFeatures.shaderBufferFloat32Atomics = VK_TRUE;
+        atomicFloatFeatures.pNext = &vulkan12Features;
+        bool atomicFloat = available("VK_EXT_shader_atomic_float");
 
         VkPhysicalDeviceFeatures2 supportedFeatures2 {};
         supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 
         VkPhysicalDeviceShaderAtomicFloatFeaturesEXT supportedAtomicFloatFeatures {};
         supportedAtomicFloatFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_FLOAT_FEATURES_EXT;
-        supportedFeatures2.pNext = &supportedAtomicFloatFeatures;
+        if (atomicFloat) supportedFeatures2.pNext = &supportedAtomicFloatFeatures;
+
+        // Subgroup size control (core since Vulkan 1.3) lets the autotuner choose the subgroup size of compute pipelines
+        VkPhysicalDeviceProperties deviceProperties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+        bool vulkan13 = deviceProperties.apiVersion >= VK_API_VERSION_1_3;
+        VkPhysicalDeviceVulkan13Features supportedVulkan13Features {};
+        supportedVulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        if (vulkan13) {
+            supportedVulkan13Features.pNext = supportedFeatures2.pNext;
+            supportedFeatures2.pNext = &supportedVulkan13Features;
+        }
 
         vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
-        if (!supportedAtomicFloatFeatures.shaderBufferFloat32AtomicAdd ||
-            !supportedAtomicFloatFeatures.shaderBufferFloat32Atomics) {
-            throw std::runtime_error("atomic float is not supported on this device.");
+        if (atomicFloat) {
+            atomicFloatFeatures.shaderBufferFloat32AtomicAdd = supportedAtomicFloatFeatures.shaderBufferFloat32AtomicAdd;
+            atomicFloatFeatures.shaderBufferFloat32Atomics = supportedAtomicFloatFeatures.shaderBufferFloat32Atomics;
+            enable("VK_EXT_shader_atomic_float");
+        }
+
+        // Subgroup arithmetic in compute shaders speeds up built-in reductions (core since Vulkan 1.1)
+        VkPhysicalDeviceVulkan11Properties vulkan11Properties {};
+        vulkan11Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES;
+        VkPhysicalDeviceProperties2 subgroupProperties2 {};
+        subgroupProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        subgroupProperties2.pNext = &vulkan11Properties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &subgroupProperties2);
+        VkSubgroupFeatureFlags arithmetic = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+        subgroupArithmetic = (vulkan11Properties.subgroupSupportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+                             (vulkan11Properties.subgroupSupportedOperations & arithmetic) == arithmetic;
+
+        VkPhysicalDeviceVulkan13Features vulkan13Features {};
+        vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+        if (vulkan13) {
+            VkPhysicalDeviceVulkan13Properties vulkan13Properties {};
+            vulkan13Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_PROPERTIES;
+            VkPhysicalDeviceProperties2 properties2 {};
+            properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties2.pNext = &vulkan13Properties;
+            vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+            subgroupSizeControl = supportedVulkan13Features.subgroupSizeControl && (vulkan13Properties.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT);
+            minSubgroupSize = vulkan13Properties.minSubgroupSize;
+            maxSubgroupSize = vulkan13Properties.maxSubgroupSize;
+            maxComputeWorkgroupSubgroups = vulkan13Properties.maxComputeWorkgroupSubgroups;
+            vulkan13Features.subgroupSizeControl = subgroupSizeControl ? VK_TRUE : VK_FALSE;
+            vulkan12Features.pNext = &vulkan13Features;
         }
 
+        // Timestamps of the compute queue are used to time dispatches
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+        timestampValidBits = queueFamilies[indices.computeFamily.value()].timestampValidBits;
+
+        // Calibrated timestamps map GPU pass times onto the host timeline of traces
+        bool calibratedTimestamps = available(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        if (calibratedTimestamps) enable(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+
+#ifdef __linux__
+        // The steady clock of the host is CLOCK_MONOTONIC, so both clocks can be sampled by the driver at once
+        auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+        if (calibratedTimestamps && getTimeDomains) {
+            uint32_t domainCount = 0;
+            getTimeDomains(physicalDevice, &domainCount, nullptr);
+            std::vector<VkTimeDomainEXT> timeDomains(domainCount);
+            getTimeDomains(physicalDevice, &domainCount, timeDomains.data());
+            monotonicTimeDomain = std::find(timeDomains.begin(), timeDomains.end(), VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT) != timeDomains.end();
+        }
+#endif
+
+        // Pipeline statistics give the profiler the shader invocations of every dispatch
+        pipelineStatisticsQuery = supportedFeatures2.features.pipelineStatisticsQuery;
+        deviceFeatures.pipelineStatisticsQuery = supportedFeatures2.features.pipelineStatisticsQuery;
+
         VkDeviceCreateInfo createInfo {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
-        createInfo.pNext = &atomicFloatFeatures;
+        createInfo.pEnabledFeatures = &deviceFeatures;
+        createInfo.pNext = atomicFloat ? static_cast<void*>(&atomicFloatFeatures) : static_cast<void*>(&vulkan12Features);
 
 #ifdef ENABLE_VALIDATION_LAYER
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -450,6 +607,36 @@ namespace NextHydro {
             throw std::runtime_error("failed to create logical m_device!");
         }
         vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+        if (calibratedTimestamps) {
+            getCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT"));
+        }
+    }
+
+    void Core::createAllocator() {
+
+        allocator = std::make_unique<Allocator>(device, physicalDevice);
+    }
+
+    void Core::createUploader() {
+
+        uploader = std::make_unique<UploadBatcher>(device, *allocator, commandPool, computeQueue);
+    }
+
+    void Core::reportMemory() const {
+
+        if (cpuBackend) {
+            cpuBackend->reportMemory();
+            return;
+        }
+        allocator->report();
+
+        if (aliasAllocations.empty()) return;
+        VkDeviceSize aliasedSize = 0;
+        for (const auto& aliasAllocation : aliasAllocations) {
+            aliasedSize += aliasAllocation->size;
+        }
+        std::cout << "Transient storages: " << aliasedBufferCount << " buffers aliased into " << aliasAllocations.size() << " allocations ("
+                  << aliasedBufferSize / 1024 << " KiB -> " << aliasedSize / 1024 << " KiB)" << std::endl;
     }
 
     void Core::createCommandPool() {
@@ -499,7 +686,7 @@ namespace NextHydro {
         vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
     }
 
-    void Core::createCommandBuffer() {
+    VkCommandBuffer Core::createCommandBuffer() {
 
         VkCommandBufferAllocateInfo allocInfo {};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -512,6 +699,7 @@ namespace NextHydro {
             throw std::runtime_error("failed to allocate compute command buffers!");
         }
         commandBuffers.emplace_back(commandBuffer);
+        return commandBuffer;
     }
 
     void Core::createFence() {
@@ -527,87 +715,326 @@ namespace NextHydro {
         fences.emplace_back(fence);
     }
 
+    fs::path Core::pipelineCacheFile() const {
+
+        if (ShaderCache::directory().empty()) return {};
+
+        // Cache data is only valid for the same device and driver
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        std::stringstream name;
+        name << "pipeline-" << std::hex << properties.vendorID << "-" << properties.deviceID << "-" << properties.driverVersion << "-";
+        for (auto byte : properties.pipelineCacheUUID) {
+            name << std::setw(2) << std::setfill('0') << static_cast<uint32_t>(byte);
+        }
+        name << ".bin";
+        return ShaderCache::directory() / name.str();
+    }
+
+    void Core::createPipelineCache() {
+
+        std::vector<char> cacheData;
+        auto path = pipelineCacheFile();
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!path.empty() && file.is_open()) {
+            cacheData.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(cacheData.data(), static_cast<std::streamsize>(cacheData.size()));
+            if (!file) cacheData.clear();
+        }
+
+        // Drop data whose header does not match the device, the driver would reject it anyway
+        if (!cacheData.empty()) {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+            VkPipelineCacheHeaderVersionOne header {};
+            bool valid = cacheData.size() >= sizeof(header);
+            if (valid) {
+                std::memcpy(&header, cacheData.data(), sizeof(header));
+                valid = header.headerSize >= sizeof(header) && header.headerSize <= cacheData.size()
+                        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                        && header.vendorID == properties.vendorID
+                        && header.deviceID == properties.deviceID
+                        && std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+            }
+            if (!valid) {
+                std::cerr << "Pipeline cache <" << path.string() << "> does not match the device, it is rebuilt." << std::endl;
+                cacheData.clear();
+            }
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo {};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = cacheData.size();
+        cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    void Core::savePipelineCache() const {
+
+        if (cpuBackend) return;
+        auto path = pipelineCacheFile();
+        if (path.empty() || pipelineCache == VK_NULL_HANDLE) return;
+
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS || !dataSize) return;
+
+        std::vector<char> cacheData(dataSize);
+        if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, cacheData.data()) != VK_SUCCESS) return;
+
+        // Saving is best effort, write to a temporary file first so that a concurrent run never reads partial data
+        std::error_code error;
+        fs::create_directories(path.parent_path(), error);
+        auto tempPath = fs::path(path).concat(".tmp");
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return;
+            file.write(cacheData.data(), static_cast<std::streamsize>(dataSize));
+            if (!file) return;
+        }
+        fs::rename(tempPath, path, error);
+        if (error) fs::remove(tempPath, error);
+    }
+
+    void Core::createSyncObjects() {
+
+        VkSemaphoreTypeCreateInfo typeInfo {};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timelineSemaphore) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timeline semaphore!");
+        }
+    }
+
     void Core::idle() const {
+        HYDRO_TRACE_SCOPE("idle");
+        if (device == VK_NULL_HANDLE) return;
         vkDeviceWaitIdle(device);
     }
 
+    void Core::waitTimeline(uint64_t value) const {
+        HYDRO_TRACE_SCOPE("waitTimeline");
+
+        VkSemaphoreWaitInfo waitInfo {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timelineSemaphore;
+        waitInfo.pValues = &value;
+
+        if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for timeline semaphore!");
+        }
+    }
+
     Buffer Core::createTempStagingBuffer(VkDeviceSize size) const {
 
-        Buffer stagingBuffer(device, "", physicalDevice,
+        // Released right after the upload, so it is carved from the linear arena of the allocator
+        Buffer stagingBuffer(device, "", *allocator,
                              size,
                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             0,
+                             true
         );
         return stagingBuffer;
     }
 
     void Core::createStagingBuffer(const std::string& name, Buffer*& uniformBuffer, VkDeviceSize size) const {
 
-        uniformBuffer = new Buffer(device, name, physicalDevice,
+        // Staging buffers are read back by the host every step, cached memory is preferred (invalidated before reads)
+        uniformBuffer = new Buffer(device, name, *allocator,
                                    size,
-                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_CACHED_BIT
         );
     }
 
     void Core::createUniformBuffer(const std::string& name, Buffer*& uniformBuffer, Block& blockMemory) const {
 
-        auto stagingBuffer = createTempStagingBuffer(blockMemory.size);
-        stagingBuffer.writeData(blockMemory.buffer.get());
-
-        uniformBuffer = new Buffer(device, name, physicalDevice,
+        uniformBuffer = new Buffer(device, name, *allocator,
                                    blockMemory.size,
                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
         );
-        copyBuffer(stagingBuffer.buffer, uniformBuffer->buffer, blockMemory.size);
+        if (blockMemory.buffer) uploader->upload(uniformBuffer, blockMemory.buffer.get(), blockMemory.size);
+        else uploader->fill(uniformBuffer, blockMemory.fillPattern);
     }
 
     void Core::createStorageBuffer(const std::string& name, Buffer*& storageBuffer, Block& blockMemory) const {
 
-        auto stagingBuffer = createTempStagingBuffer(blockMemory.size);
-        stagingBuffer.writeData(blockMemory.buffer.get());
-
-        storageBuffer = new Buffer(device, name, physicalDevice,
+        storageBuffer = new Buffer(device, name, *allocator,
                                    blockMemory.size,
-                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
         );
-        copyBuffer(stagingBuffer.buffer, storageBuffer->buffer, blockMemory.size);
+        if (blockMemory.buffer) uploader->upload(storageBuffer, blockMemory.buffer.get(), blockMemory.size);
+        else uploader->fill(storageBuffer, blockMemory.fillPattern);
+    }
+
+    void Core::createControlBuffer(const std::string& name, Buffer*& controlBuffer, const std::vector<uint32_t>& data) const {
+
+        VkDeviceSize size = data.size() * sizeof(uint32_t);
+        controlBuffer = new Buffer(device, name, *allocator,
+                                   size,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+        );
+        uploader->upload(controlBuffer, reinterpret_cast<const char*>(data.data()), size);
+    }
+
+    void Core::createGuard(PollableCommandNode* node) {
+
+        // Guard pipelines evaluating the termination condition of the node on the device,
+        // the priming one guards the first iteration of frames submitted without a host check (see BuiltinShaders::guard)
+        std::array<uint32_t, 3> groupCounts = { 1, 1, 1 };
+        for (uint32_t priming = 0; priming < 2; ++priming) {
+            std::string shader = (priming ? "__PRIMING_GUARD__" : "__GUARD__") + node->name;
+            SpecializationConstants specialization = { { 0, priming } };
+            const auto& pipeline = name_pipeline_map.emplace(shader, std::make_shared<ComputePipeline>(device, shader.c_str(), BuiltinShaders::guard, pipelineCache, ShaderDefines {}, specialization)).first->second;
+
+            VkDescriptorSetAllocateInfo allocInfo {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorSetCount = static_cast<uint32_t>(pipeline->descriptorSetLayout.size());
+            allocInfo.pSetLayouts = pipeline->descriptorSetLayout.data();
+            allocInfo.descriptorPool = descriptorPool;
+            if (vkAllocateDescriptorSets(device, &allocInfo, pipeline->descriptorSets.data()) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate descriptor sets for guard pipeline!");
+            }
+
+            (priming ? node->primingGuardPass : node->guardPass) = std::make_shared<ComputePass>(shader, shader, groupCounts, groupCounts);
+        }
+
+        updateGuard(node);
+    }
+
+    void Core::updateGuard(PollableCommandNode* node) {
+
+        // Control buffer holding the indirect dispatch commands of all passes in the node
+        Buffer* buffer = nullptr;
+        std::string bufferName = "Control Buffer for " + node->name;
+        createControlBuffer(bufferName, buffer, node->controlData());
+
+        auto it = name_buffer_map.find(bufferName);
+        if (it != name_buffer_map.end()) {
+            it->second->release();
+            name_buffer_map.erase(it);
+        }
+        node->controlBuffer = name_buffer_map.emplace(bufferName, std::shared_ptr<Buffer>(buffer)).first->second;
+
+        // Binding <flagBuffer> and <controlBuffer> directly, both of them are not part of the descriptor set pool
+        std::array<VkDescriptorBufferInfo, 2> bufferInfos = {
+                node->flagBuffer->getDescriptorBufferInfo(),
+                node->controlBuffer->getDescriptorBufferInfo()
+        };
+        for (const auto& guardPass : { node->guardPass, node->primingGuardPass }) {
+            const auto& pipeline = name_pipeline_map[guardPass->shader];
+            std::array<VkWriteDescriptorSet, 2> writeSets {};
+            for (uint32_t i = 0; i < writeSets.size(); ++i) {
+                writeSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writeSets[i].dstSet = pipeline->descriptorSets[0];
+                writeSets[i].dstBinding = i;
+                writeSets[i].dstArrayElement = 0;
+                writeSets[i].descriptorCount = 1;
+                writeSets[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writeSets[i].pBufferInfo = &bufferInfos[i];
+            }
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeSets.size()), writeSets.data(), 0, nullptr);
+
+            for (size_t i = 0; i < pipeline->bindingResourceInfo.size(); ++i) {
+                auto bindingId = pipeline->bindingResourceInfo[i][1];
+                pipeline->bindingResources[i] = bindingId == 0 ? node->flagBuffer.get() : node->controlBuffer.get();
+            }
+        }
     }
 
     void Core::preheat() {
+        HYDRO_TRACE_SCOPE("preheat");
         if (currentFenceIndex == fences.size()) createFence();
         const auto& fence = fences[currentFenceIndex];
 
         vkResetFences(device, 1, &fence);
     }
 
-    void Core::submit() {
+    void Core::submit(const VkCommandBuffer& commandBuffer) {
         const auto& fence = fences[currentFenceIndex++];
 
         VkSubmitInfo submitInfo {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.pCommandBuffers = commandBuffers.data();
-        submitInfo.commandBufferCount = currentCommandBufferIndex;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.commandBufferCount = 1;
 
-        if (vkQueueSubmit(computeQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit compute command buffer!");
+        {
+            HYDRO_TRACE_SCOPE("submit");
+            if (profiler) profiler->submitted(commandBuffer);
+            if (vkQueueSubmit(computeQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit compute command buffer!");
+            }
         }
 
-        currentCommandBufferIndex = 0;
+        HYDRO_TRACE_SCOPE("waitFence");
         vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
         currentFenceIndex = 0;
     }
 
-    VkCommandBuffer Core::commandBegin() {
-        if (currentCommandBufferIndex == commandBuffers.size()) createCommandBuffer();
+    void Core::submitFrame(const std::vector<VkCommandBuffer>& frameCommandBuffers, uint64_t signalValue) {
+        HYDRO_TRACE_SCOPE("submitFrame");
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+        VkSubmitInfo submitInfo {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.pCommandBuffers = frameCommandBuffers.data();
+        submitInfo.commandBufferCount = static_cast<uint32_t>(frameCommandBuffers.size());
+        submitInfo.pSignalSemaphores = &timelineSemaphore;
+        submitInfo.signalSemaphoreCount = 1;
+
+        if (profiler) {
+            for (const auto& commandBuffer : frameCommandBuffers) profiler->submitted(commandBuffer);
+        }
+        if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit compute frame!");
+        }
+    }
+
+    void Core::createReadback(PollableCommandNode* node, uint32_t frames) {
+
+        // One flag slot per frame in flight
+        Buffer* buffer = nullptr;
+        std::string bufferName = "Flag Readback Buffer for " + node->name;
+        createStagingBuffer(bufferName, buffer, std::max<uint32_t>(frames, 1) * 4);
+
+        auto it = name_buffer_map.find(bufferName);
+        if (it != name_buffer_map.end()) {
+            it->second->release();
+            name_buffer_map.erase(it);
+        }
+        node->useReadback(name_buffer_map.emplace(bufferName, std::shared_ptr<Buffer>(buffer)).first->second.get());
+    }
 
-        auto commandBuffer = commandBuffers[currentCommandBufferIndex];
-        vkResetCommandBuffer(commandBuffer, 0);
+    VkCommandBuffer Core::commandBegin(VkCommandBufferUsageFlags flags) {
+        HYDRO_TRACE_SCOPE("commandBegin");
+        auto commandBuffer = createCommandBuffer();
 
         VkCommandBufferBeginInfo beginInfo {};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = flags;
 
         if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
             throw std::runtime_error("failed to begin recording compute command buffer!");
@@ -615,25 +1042,52 @@ namespace NextHydro {
         return commandBuffer;
     }
 
-    void Core::dispatch(const VkCommandBuffer& commandBuffer, const ComputePipeline* pipeline, const std::array<uint32_t, 3> groupCounts) {
+    void Core::dispatch(const VkCommandBuffer& commandBuffer, const ComputePipeline* pipeline, const std::array<uint32_t, 3> groupCounts, size_t parity) {
 
+        const auto& descriptorSets = pipeline->descriptorSetsOf(parity);
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
         vkCmdBindDescriptorSets(
                 commandBuffer,
                 VK_PIPELINE_BIND_POINT_COMPUTE,
                 pipeline->pipelineLayout,
                 0,
-                pipeline->descriptorSets.size(),
-                pipeline->descriptorSets.data(),
+                descriptorSets.size(),
+                descriptorSets.data(),
                 0,
                 nullptr
         );
         vkCmdDispatch(commandBuffer, groupCounts[0], groupCounts[1], groupCounts[2]);
     }
 
-    void Core::commandEnd() {
+    void Core::dispatchIndirect(const VkCommandBuffer& commandBuffer, const ComputePipeline* pipeline, VkBuffer indirectBuffer, VkDeviceSize offset, size_t parity) {
+
+        const auto& descriptorSets = pipeline->descriptorSetsOf(parity);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+        vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                pipeline->pipelineLayout,
+                0,
+                descriptorSets.size(),
+                descriptorSets.data(),
+                0,
+                nullptr
+        );
+        vkCmdDispatchIndirect(commandBuffer, indirectBuffer, offset);
+    }
+
+    void Core::barrier(const VkCommandBuffer& commandBuffer, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+
+        VkMemoryBarrier memoryBarrier {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = srcAccess;
+        memoryBarrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+    }
+
+    void Core::commandEnd(const VkCommandBuffer& commandBuffer) {
 
-        if (vkEndCommandBuffer(commandBuffers[currentCommandBufferIndex++]) != VK_SUCCESS) {
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
             throw std::runtime_error("failed to record compute command buffer!");
         }
     }
@@ -642,10 +1096,139 @@ namespace NextHydro {
         vkUpdateDescriptorSets(device, descriptorWriteSets.size(), descriptorWriteSets.data(), descriptorCopySets.size(), descriptorCopySets.data());
     }
 
+    std::vector<VkCopyDescriptorSet> Core::bindPipeline(const std::shared_ptr<ComputePipeline>& pipeline) {
+
+        const auto& name = pipeline->name;
+
+        // Workgroup size and shared memory must be supported by the device
+        const auto& limits = allocator->limits();
+        const auto& localSize = pipeline->localSize;
+        if (localSize[0] > limits.maxComputeWorkGroupSize[0] || localSize[1] > limits.maxComputeWorkGroupSize[1] || localSize[2] > limits.maxComputeWorkGroupSize[2] ||
+            static_cast<uint64_t>(localSize[0]) * localSize[1] * localSize[2] > limits.maxComputeWorkGroupInvocations) {
+            throw std::runtime_error("workgroup size (" + std::to_string(localSize[0]) + ", " + std::to_string(localSize[1]) + ", " + std::to_string(localSize[2]) +
+                                     ") of pipeline <" + name + "> exceeds the limits of the device.");
+        }
+        if (pipeline->sharedMemorySize > limits.maxComputeSharedMemorySize) {
+            throw std::runtime_error("shared memory of " + std::to_string(pipeline->sharedMemorySize) + " bytes of pipeline <" + name + "> exceeds the limit of the device.");
+        }
+
+        // Allocate descriptor sets for pipeline
+        VkDescriptorSetAllocateInfo pipelineAllocInfo {};
+        pipelineAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        pipelineAllocInfo.descriptorSetCount = static_cast<uint32_t>(pipeline->descriptorSetLayout.size());
+        pipelineAllocInfo.pSetLayouts = pipeline->descriptorSetLayout.data();
+        pipelineAllocInfo.descriptorPool = descriptorPool;
+
+        if (vkAllocateDescriptorSets(device, &pipelineAllocInfo, pipeline->descriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets for pipeline!");
+        }
+
+        // Make connection between <descriptorSetPool> of Core and <descriptorSets> of pipeline
+        std::vector<VkCopyDescriptorSet> copies;
+        for (size_t i = 0; i < pipeline->bindingResourceNames.size(); ++i) {
+            auto bindingName = pipeline->bindingResourceNames[i];
+            auto bindingId = pipeline->bindingResourceInfo[i][1];
+            auto bindingSet = pipeline->bindingResourceInfo[i][0];
+            const auto& bindingInfo = buffer_descriptorSetPool_map[bindingName];
+            pipeline->bindingResources[i] = name_buffer_map[bindingName].get();
+
+            // Array stride declared in GLSL must match the packing of the storage
+            auto strideIt = buffer_stride_map.find(bindingName);
+            auto shaderStride = pipeline->bindingArrayStride[i];
+            if (strideIt != buffer_stride_map.end() && shaderStride && shaderStride != strideIt->second) {
+                throw std::runtime_error("array stride of <" + bindingName + "> in pipeline <" + name + "> is " + std::to_string(shaderStride) +
+                                         " bytes, but the storage is packed with " + std::to_string(strideIt->second) + " bytes.");
+            }
+
+            VkCopyDescriptorSet copyDescriptorSet {};
+            copyDescriptorSet.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
+            copyDescriptorSet.srcSet = descriptorSetPool[bindingInfo[0]];
+            copyDescriptorSet.srcBinding = bindingInfo[1];
+            copyDescriptorSet.srcArrayElement = 0;
+            copyDescriptorSet.dstSet = pipeline->descriptorSets[bindingSet];
+            copyDescriptorSet.dstBinding = bindingId;
+            copyDescriptorSet.dstArrayElement = 0;
+            copyDescriptorSet.descriptorCount = 1;
+            copies.emplace_back(copyDescriptorSet);
+        }
+
+        // Pipelines binding a double-buffered storage get a second variant of their sets, copied from the swapped storage set of the pool
+        bool flips = std::any_of(pipeline->bindingResourceNames.begin(), pipeline->bindingResourceNames.end(), [this](const std::string& bindingName) {
+            return buffer_pair_map.count(bindingName) > 0;
+        });
+        if (!flips) return copies;
+
+        pipeline->flippedDescriptorSets.resize(pipeline->descriptorSets.size());
+        if (vkAllocateDescriptorSets(device, &pipelineAllocInfo, pipeline->flippedDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate flipped descriptor sets for pipeline!");
+        }
+        pipeline->flippedBindingResources = pipeline->bindingResources;
+        for (size_t i = 0, count = copies.size(); i < count; ++i) {
+            auto copyDescriptorSet = copies[i];
+            const auto& bindingName = pipeline->bindingResourceNames[i];
+            if (buffer_descriptorSetPool_map[bindingName][0] == 0) copyDescriptorSet.srcSet = descriptorSetPool[2];
+            copyDescriptorSet.dstSet = pipeline->flippedDescriptorSets[pipeline->bindingResourceInfo[i][0]];
+            copies.emplace_back(copyDescriptorSet);
+
+            auto pairIt = buffer_pair_map.find(bindingName);
+            if (pairIt != buffer_pair_map.end()) pipeline->flippedBindingResources[i] = name_buffer_map[pairIt->second].get();
+        }
+        return copies;
+    }
+
+    void Core::destroyPipeline(ComputePipeline* pipeline) const {
+
+        auto module = pipeline->computeShaderModule->module;
+        if (module != VK_NULL_HANDLE) {
+            vkDestroyShaderModule(device, module, nullptr);
+        }
+
+        for (const auto& layout : pipeline->descriptorSetLayout) {
+            if (layout != VK_NULL_HANDLE) {
+                vkDestroyDescriptorSetLayout(device, layout, nullptr);
+            }
+        }
+
+        if (pipeline->pipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(device, pipeline->pipelineLayout, nullptr);
+        }
+
+        if (pipeline->pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, pipeline->pipeline, nullptr);
+        }
+    }
+
+    std::array<uint32_t, 3> Core::groupCountsFor(const std::string& passName, const ComputePipeline* pipeline, const std::array<uint32_t, 3>& computeScale) const {
+
+        // Cover the compute scale with workgroups of the size declared by the shader
+        const auto& localSize = pipeline->localSize;
+        const auto& limits = allocator->limits();
+        std::array<uint32_t , 3> groupCounts {};
+        for (size_t d = 0; d < 3; ++d) {
+            groupCounts[d] = (computeScale[d] + localSize[d] - 1) / localSize[d];
+            if (groupCounts[d] > limits.maxComputeWorkGroupCount[d]) {
+                throw std::runtime_error("pass <" + passName + "> needs " + std::to_string(groupCounts[d]) + " workgroups in dimension " + std::to_string(d) +
+                                         ", but the device supports " + std::to_string(limits.maxComputeWorkGroupCount[d]) + ".");
+            }
+        }
+        return groupCounts;
+    }
+
     void Core::parseScript(const std::string& path) {
 
-        // Read json
-        Json script = readJsonFile(path);
+        parseScript(readJsonFile(path));
+    }
+
+    void Core::parseScript(const Json& script) {
+        HYDRO_TRACE_SCOPE("parseScript");
+
+        if (cpuBackend) {
+            cpuBackend->parseScript(script);
+            return;
+        }
+
+        // Tuned values of the device fill in what the script leaves open
+        loadTuningDatabase();
 
         // Get assets
         const auto& pipelines = script["pipelines"];
@@ -654,35 +1237,128 @@ namespace NextHydro {
         const auto& passes = script["passes"];
         const auto& flow = script["flow"];
 
+        // Startup is a task graph on a thread pool:
+        // workers compile and reflect the shaders of all pipelines and build the blocks of all resources,
+        // this thread creates buffers and uploads blocks as they get ready, descriptors are wired once both sides exist
+        ThreadPool pool;
+
+        // Launch pipeline creation (shaderc, reflection and pipeline creation through the cache are thread-safe)
+        std::vector<std::future<std::shared_ptr<ComputePipeline>>> pipelineTasks;
+        for (const auto& pipelineInfo: pipelines) {
+            pipelineTasks.emplace_back(pool.submit([this, &pipelineInfo] {
+                auto name = pipelineInfo["name"].get<std::string>();
+                auto glslCode = readShaderFile(pipelineInfo["path"].get<std::string>());
+
+                // Optional preprocessor definitions, e.g. "defines": { "USE_FLUX_LIMITER": 1 }
+                ShaderDefines defines;
+                if (pipelineInfo.contains("defines")) {
+                    for (const auto& [macro, value] : pipelineInfo["defines"].items()) {
+                        defines.emplace_back(macro, value.is_string() ? value.get<std::string>() : value.dump());
+                    }
+                }
+
+                // Optional specialization constants, e.g. "specialization": { "0": 16, "1": 16 } for local_size_x_id = 0, local_size_y_id = 1
+                SpecializationConstants specialization;
+                if (pipelineInfo.contains("specialization")) {
+                    for (const auto& [constantId, value] : pipelineInfo["specialization"].items()) {
+                        specialization[static_cast<uint32_t>(std::stoul(constantId))] = value.get<uint32_t>();
+                    }
+                }
+                uint32_t subgroupSize = pipelineInfo.value("subgroupSize", 0u);
+
+                // Values tuned for this device fill in what the script leaves open
+                const Json& database = tuningDatabase;
+                auto tunedPipelines = database.find("pipelines");
+                if (tunedPipelines != database.end()) {
+                    auto tuned = tunedPipelines->find(ShaderCache::key(glslCode, defines, shaderCompileSignature()));
+                    if (tuned != tunedPipelines->end()) {
+                        for (const auto& [constantId, value] : tuned->value("specialization", Json::object()).items()) {
+                            specialization.emplace(static_cast<uint32_t>(std::stoul(constantId)), value.get<uint32_t>());
+                        }
+                        if (!pipelineInfo.contains("subgroupSize")) subgroupSize = tuned->value("subgroupSize", 0u);
+                    }
+                }
+                if (!subgroupSizeControl) subgroupSize = 0;
+                return std::make_shared<ComputePipeline>(device, name.c_str(), glslCode.c_str(), pipelineCache, defines, specialization, subgroupSize);
+            }));
+        }
+
+        // Launch block construction of storages (packed as declared by the storage, or the script default) and uniforms
+        std::string defaultPacking = script.value("packing", "std140");
+        std::vector<std::future<Block>> storageTasks;
+        std::vector<std::future<Block>> uniformTasks;
+        for (const auto& storageInfo: storages) {
+            storageTasks.emplace_back(pool.submit([&storageInfo, &defaultPacking] {
+                return Block(storageInfo["layout"], storageInfo["resource"], parsePacking(storageInfo.value("packing", defaultPacking)));
+            }));
+        }
+        for (const auto& uniformInfo: uniforms) {
+            uniformTasks.emplace_back(pool.submit([&uniformInfo] {
+                return Block(uniformInfo["layout"], uniformInfo["resource"]);
+            }));
+        }
+
         // Create storages
         uint32_t bindingIndex = 0;
+        size_t storageIndex = 0;
+        std::vector<std::string> transientNames;
         for (const auto& storageInfo: storages) {
             Buffer* buffer = nullptr;
             std::string name = storageInfo["name"];
-            const Json& layout = storageInfo["layout"];
             const Json& resource = storageInfo["resource"];
-            Block block(layout, resource);
-            createStorageBuffer(name, buffer, block);
+            Block block = storageTasks[storageIndex++].get();
+
+            // Transient storages hold no data across passes of different iterations, their memory is bound once liveness is known
+            if (storageInfo.value("transient", false)) {
+                if (resource.is_array()) throw std::runtime_error("transient storage <" + name + "> can not have initial data.");
+                buffer = new Buffer(device, name, *allocator, block.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+                transientNames.emplace_back(name);
+            } else {
+                createStorageBuffer(name, buffer, block);
+            }
             name_buffer_map.emplace(name, std::shared_ptr<Buffer>(buffer));
+            buffer_stride_map.emplace(name, block.stride);
             buffer_descriptorSetPool_map.emplace(name, std::array<uint32_t, 2>{ 0, bindingIndex++});
+
+            // Double-buffered storages get a second buffer with the same initial data, named <previous> (defaults to <name>_prev)
+            if (storageInfo.value("doubleBuffered", false)) {
+                if (storageInfo.value("transient", false)) throw std::runtime_error("transient storage <" + name + "> can not be double-buffered.");
+                std::string previous = storageInfo.value("previous", name + "_prev");
+                Buffer* previousBuffer = nullptr;
+                createStorageBuffer(previous, previousBuffer, block);
+                name_buffer_map.emplace(previous, std::shared_ptr<Buffer>(previousBuffer));
+                buffer_stride_map.emplace(previous, block.stride);
+                buffer_descriptorSetPool_map.emplace(previous, std::array<uint32_t, 2>{ 0, bindingIndex++});
+                buffer_pair_map.emplace(name, previous);
+                buffer_pair_map.emplace(previous, name);
+            }
         }
+        uint32_t storageBufferNum = bindingIndex;
 
         // Create uniforms
         bindingIndex = 0;
+        size_t uniformIndex = 0;
         for (const auto& uniformInfo: uniforms ) {
             Buffer* buffer = nullptr;
             std::string name = uniformInfo["name"];
-            const Json& layout = uniformInfo["layout"];
-            const Json& resource = uniformInfo["resource"];
-            Block block(layout, resource);
+            Block block = uniformTasks[uniformIndex++].get();
             createUniformBuffer(name, buffer, block);
             name_buffer_map.emplace(name, std::shared_ptr<Buffer>(buffer));
             buffer_descriptorSetPool_map.emplace(name, std::array<uint32_t , 2>{ 1, bindingIndex++});
         }
 
+        // Upload all resources, the transfer runs while workers are still compiling shaders
+        uploader->flush();
+
+        // Launch pipelines of built-in reduction passes, the number of values is known once the source storage exists
+        // e.g. { "name": "updateDtPass", "reduce": { "operation": "min", "source": "dt3", "target": "scalars", "targetIndex": 0, "ignore": 0.0 } }
+        std::vector<std::array<std::future<std::shared_ptr<ComputePipeline>>, 2>> reductionTasks;
+        for (const auto& passInfo : passes) {
+            if (passInfo.contains("reduce")) reductionTasks.emplace_back(createReduction(passInfo, pool));
+        }
+
         // Create descriptor pool
         uint32_t sizeFactor = 100;
-        uint32_t storageBufferNum = storages.size();
         uint32_t uniformBufferNum = uniforms.size();
         std::vector<VkDescriptorPoolSize> poolSizes;
         if (storageBufferNum > 0) poolSizes.push_back({
@@ -695,6 +1371,7 @@ namespace NextHydro {
                                                       });
         VkDescriptorPoolCreateInfo poolInfo {};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
         poolInfo.maxSets = 2 * sizeFactor;
@@ -740,6 +1417,9 @@ namespace NextHydro {
             throw std::runtime_error("failed to create uniform descriptor set layout!");
         }
 
+        // - Storage buffers with double-buffered storages swapped (set 2 of the pool, only if any storage is double-buffered)
+        if (!buffer_pair_map.empty()) descriptorSetLayouts.push_back(descriptorSetLayouts[0]);
+
         // Allocate descriptor set in GPU
         VkDescriptorSetAllocateInfo allocInfo {};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -774,71 +1454,76 @@ namespace NextHydro {
             descriptorWriteSets[bindingIndex].descriptorType = descriptorType;
             descriptorWriteSets[bindingIndex].pBufferInfo = &name_buffer_map[bufferName].get()->getDescriptorBufferInfo(0, 0);
             bindingIndex++;
-        }
-
-        // Create pipelines
-        for (const auto& pipelineInfo: pipelines) {
-            auto name = pipelineInfo["name"].get<std::string>();
-            auto glslCode = readShaderFile(pipelineInfo["path"].get<std::string>());
-            const auto& pipeline = name_pipeline_map.emplace(name, std::make_shared<ComputePipeline>(device, name.c_str(), glslCode.c_str())).first->second;
-
-            // Allocate descriptor sets for pipeline
-            VkDescriptorSetAllocateInfo pipelineAllocInfo {};
-            pipelineAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            pipelineAllocInfo.descriptorSetCount = static_cast<uint32_t>(pipeline->descriptorSetLayout.size());
-            pipelineAllocInfo.pSetLayouts = pipeline->descriptorSetLayout.data();
-            pipelineAllocInfo.descriptorPool = descriptorPool;
 
-            if (vkAllocateDescriptorSets(device, &pipelineAllocInfo, pipeline->descriptorSets.data()) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate descriptor sets for pipeline!");
+            // Swapped set binds the other buffer of a pair under the same binding
+            if (bindingInfo[0] == 0 && descriptorSetPool.size() > 2) {
+                auto pairIt = buffer_pair_map.find(bufferName);
+                auto swappedWrite = descriptorWriteSets[bindingIndex - 1];
+                swappedWrite.dstSet = descriptorSetPool[2];
+                if (pairIt != buffer_pair_map.end()) swappedWrite.pBufferInfo = &name_buffer_map[pairIt->second].get()->getDescriptorBufferInfo(0, 0);
+                descriptorWriteSets.push_back(swappedWrite);
             }
+        }
 
-            // Make connection between <descriptorSetPool> of Core and <descriptorSets> of pipeline
-            for (size_t i = 0; i < pipeline->bindingResourceNames.size(); ++i) {
-                auto bindingName = pipeline->bindingResourceNames[i];
-                auto bindingId = pipeline->bindingResourceInfo[i][1];
-                auto bindingSet = pipeline->bindingResourceInfo[i][0];
-                const auto& bindingInfo = buffer_descriptorSetPool_map[bindingName];
+        // Wire pipelines in script order as they get ready
+        for (auto& pipelineTask : pipelineTasks) {
+            auto pipeline = pipelineTask.get();
+            const auto& name = pipeline->name;
+            name_pipeline_map.emplace(name, pipeline);
+
+            auto copies = bindPipeline(pipeline);
+            descriptorCopySets.insert(descriptorCopySets.end(), copies.begin(), copies.end());
+        }
 
-                VkCopyDescriptorSet copyDescriptorSet {};
-                copyDescriptorSet.sType = VK_STRUCTURE_TYPE_COPY_DESCRIPTOR_SET;
-                copyDescriptorSet.srcSet = descriptorSetPool[bindingInfo[0]];
-                copyDescriptorSet.srcBinding = bindingInfo[1];
-                copyDescriptorSet.srcArrayElement = 0;
-                copyDescriptorSet.dstSet = pipeline->descriptorSets[bindingSet];
-                copyDescriptorSet.dstBinding = bindingId;
-                copyDescriptorSet.dstArrayElement = 0;
-                copyDescriptorSet.descriptorCount = 1;
-                descriptorCopySets.emplace_back(copyDescriptorSet);
+        for (auto& stageTasks : reductionTasks) {
+            for (auto& stageTask : stageTasks) {
+                auto pipeline = stageTask.get();
+                name_pipeline_map.emplace(pipeline->name, pipeline);
             }
         }
 
+        // Alias memory of transient storages not alive at the same time
+        aliasTransientBuffers(transientNames, passes, flow);
+
         // Binding all resources to descriptor sets
         updateBindings();
 
         // Create passes
         for (const auto& passInfo: passes) {
             std::string name = passInfo["name"];
+            if (passInfo.contains("reduce")) {
+                bindReduction(passInfo);
+                continue;
+            }
             std::string shader = passInfo["shader"];
             std::array<uint32_t , 3> computeScale = passInfo["computeScale"];
-            auto groupWidth = sqrt(static_cast<double>(maxComputeWorkGroupInvocations));
-            auto groupHeight = groupWidth;
-            double groupDepth = 1.0;
-            auto x = static_cast<uint32_t>(ceil(computeScale[0] / groupWidth));
-            auto y = static_cast<uint32_t>(ceil(computeScale[1] / groupHeight));
-            auto z = static_cast<uint32_t>(ceil(computeScale[2] / groupDepth));
-            std::array<uint32_t , 3> groupCounts = { x, y, z };
 
-            name_pass_map.emplace(name, std::make_shared<ComputePass>(shader, groupCounts));
+            auto pipelineIt = name_pipeline_map.find(shader);
+            if (pipelineIt == name_pipeline_map.end()) {
+                throw std::runtime_error("pipeline <" + shader + "> of pass <" + name + "> is not declared.");
+            }
+            auto groupCounts = groupCountsFor(name, pipelineIt->second.get(), computeScale);
+
+            name_pass_map.emplace(name, std::make_shared<ComputePass>(name, shader, computeScale, groupCounts));
         }
 
+        // Tune workgroup sizes before any command buffer is recorded
+        if (autotuneEnabled) autotune();
+
         // Create flowNodes
         for (const auto& nodeInfo : flow) {
             std::string nodeName = nodeInfo["nodeName"];
             std::vector<std::string> passNames = nodeInfo["passes"];
-            std::vector<std::shared_ptr<ComputePass>> passPointers(passNames.size());
-            for (size_t i = 0; i < passNames.size(); ++i) {
-                passPointers[i] = name_pass_map[passNames[i]];
+            std::vector<std::shared_ptr<ComputePass>> passPointers;
+            for (const auto& passName : passNames) {
+                auto stagesIt = pass_stages_map.find(passName);
+                if (stagesIt == pass_stages_map.end()) {
+                    passPointers.push_back(name_pass_map[passName]);
+                    continue;
+                }
+                for (const auto& stage : stagesIt->second) {
+                    passPointers.push_back(name_pass_map[stage]);
+                }
             }
             switch (nodeInfo["type"].get<size_t>()) {
                 case 0b01:{
@@ -847,6 +1532,9 @@ namespace NextHydro {
                     break;
                 }
                 case 0b11: {
+                    if (buffer_pair_map.count(nodeInfo["flagBuffer"].get<std::string>())) {
+                        throw std::runtime_error("flag buffer of node <" + nodeName + "> can not be double-buffered.");
+                    }
                     std::shared_ptr<Buffer> flagBuffer = name_buffer_map[nodeInfo["flagBuffer"]];
                     std::string operation = nodeInfo["operation"];
                     size_t flagIndex = nodeInfo["flagIndex"];
@@ -859,52 +1547,892 @@ namespace NextHydro {
                         name_buffer_map.emplace(bufferName, std::shared_ptr<Buffer>(buffer));
                     }
 
-                    flowNode_list.emplace_back(std::make_unique<PollableCommandNode>(nodeName, device, passPointers, flagBuffer, buffer, operation, flagIndex, flag, isDiscrete));
+                    auto node = std::make_unique<PollableCommandNode>(nodeName, device, passPointers, flagBuffer, buffer, operation, flagIndex, flag, isDiscrete);
+                    node->pollInterval = std::max<size_t>(nodeInfo.value("pollInterval", 1), 1);
+                    createGuard(node.get());
+                    flowNode_list.emplace_back(std::move(node));
                     break;
                 }
             }
         }
+
+        // Record command buffers of all nodes once, steps only resubmit them
+        for (const auto& node : flowNode_list) {
+            recordNode(node.get(), 1);
+        }
     }
 
-    void Core::runScript() {
+    void Core::aliasTransientBuffers(const std::vector<std::string>& transientNames, const Json& passes, const Json& flow) {
 
-        Flag flag {};
-        const auto buffer = name_buffer_map["scalars"];
-        for (const auto& node : flowNode_list) {
+        if (transientNames.empty()) return;
 
-            node->tick();
+        // Liveness of transient buffers: interval of passes using them inside every node [ node index, first pass, last pass ]
+        // Resources used by every pass: reflected from its pipeline, or the source and target of a reduction
+        std::unordered_map<std::string, std::vector<std::string>> pass_resources_map;
+        for (const auto& passInfo : passes) {
+            auto& resources = pass_resources_map[passInfo["name"].get<std::string>()];
+            if (passInfo.contains("reduce")) {
+                resources = { passInfo["reduce"]["source"].get<std::string>(), passInfo["reduce"]["target"].get<std::string>() };
+                continue;
+            }
+            const auto& pipeline = name_pipeline_map[passInfo["shader"].get<std::string>()];
+            for (size_t i = 0; i < pipeline->bindingResourceNames.size(); ++i) {
+                if (pipeline->bindingResourceAccess[i]) resources.push_back(pipeline->bindingResourceNames[i]);
+            }
+        }
+        std::unordered_map<std::string, std::vector<std::array<size_t, 3>>> buffer_liveness_map;
+        for (const auto& name : transientNames) buffer_liveness_map[name];
+
+        for (size_t nodeIndex = 0; nodeIndex < flow.size(); ++nodeIndex) {
+            std::vector<std::string> passNames = flow[nodeIndex]["passes"];
+            for (size_t passIndex = 0; passIndex < passNames.size(); ++passIndex) {
+                for (const auto& resource : pass_resources_map[passNames[passIndex]]) {
+                    auto it = buffer_liveness_map.find(resource);
+                    if (it == buffer_liveness_map.end()) continue;
+
+                    auto& intervals = it->second;
+                    if (intervals.empty() || intervals.back()[0] != nodeIndex) intervals.push_back({ nodeIndex, passIndex, passIndex });
+                    intervals.back()[2] = passIndex;
+                }
+            }
+        }
 
-            while(!node->isComplete()) {
+        auto overlapped = [&buffer_liveness_map](const std::string& a, const std::string& b) -> bool {
+            for (const auto& intervalA : buffer_liveness_map[a]) {
+                for (const auto& intervalB : buffer_liveness_map[b]) {
+                    if (intervalA[0] == intervalB[0] && intervalA[1] <= intervalB[2] && intervalB[1] <= intervalA[2]) return true;
+                }
+            }
+            return false;
+        };
+
+        // Greedy assignment of buffers (largest first) to alias groups whose members are never alive together
+        auto sortedNames = transientNames;
+        std::sort(sortedNames.begin(), sortedNames.end(), [this](const std::string& a, const std::string& b) {
+            return name_buffer_map[a]->size > name_buffer_map[b]->size;
+        });
+        std::vector<std::vector<std::string>> groups;
+        for (const auto& name : sortedNames) {
+            auto group = std::find_if(groups.begin(), groups.end(), [&](const std::vector<std::string>& members) {
+                return std::none_of(members.begin(), members.end(), [&](const std::string& member) { return overlapped(name, member); });
+            });
+            if (group == groups.end()) groups.emplace_back(std::vector<std::string>{ name });
+            else group->emplace_back(name);
+        }
 
-                executeNode(node.get());
+        // One allocation per group, satisfying the requirements of all members
+        VkDeviceSize transientSize = 0;
+        for (const auto& members : groups) {
+            VkMemoryRequirements groupRequirements {};
+            groupRequirements.memoryTypeBits = ~0u;
+            VkBufferUsageFlags groupUsage = 0;
+            for (const auto& member : members) {
+                const auto& buffer = name_buffer_map[member];
+                auto requirements = buffer->getMemoryRequirements();
+                groupRequirements.size = std::max(groupRequirements.size, requirements.size);
+                groupRequirements.alignment = std::max(groupRequirements.alignment, requirements.alignment);
+                groupRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+                groupUsage |= buffer->usageFlags;
+                transientSize += requirements.size;
+            }
 
-                buffer->readFlag(flag, 0);
-                std::cout << "Dt: " << float(flag.u) / 10000.0 << std::endl;
+            auto aliasAllocation = std::make_shared<Allocation>(allocator->allocate(groupRequirements, groupUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT));
+            for (const auto& member : members) {
+                name_buffer_map[member]->bindAlias(aliasAllocation);
             }
+            aliasAllocations.emplace_back(aliasAllocation);
         }
 
-        // Wait for end
-        idle();
+        // Reported by reportMemory
+        aliasedBufferCount += transientNames.size();
+        aliasedBufferSize += transientSize;
     }
 
-    void Core::executeNode(ICommandNode* node) {
+    std::array<std::future<std::shared_ptr<ComputePipeline>>, 2> Core::createReduction(const Json& passInfo, ThreadPool& pool) {
 
-        preheat();
-        auto commandBuffer = commandBegin();
+        std::string name = passInfo["name"];
+        const auto& reduceInfo = passInfo["reduce"];
+        std::string source = reduceInfo["source"];
+        std::string target = reduceInfo["target"];
+        std::string operation = reduceInfo.value("operation", "min");
+        uint32_t targetIndex = reduceInfo.value("targetIndex", 0u);
 
-        for (const auto& pass: node->passes) {
-            Core::dispatch(commandBuffer, name_pipeline_map[pass->shader].get(), pass->groupCounts);
+        static const std::unordered_map<std::string, uint32_t> operations = { {"min", 0}, {"max", 1}, {"sum", 2} };
+        auto operationIt = operations.find(operation);
+        if (operationIt == operations.end()) {
+            throw std::runtime_error("reduction pass <" + name + "> has unknown operation <" + operation + ">.");
         }
-        node->postProcess(commandBuffer);
-
-        commandEnd();
-        submit();
-    }
+
+        // Source is a tightly packed F32 storage, target a storage holding the result as the 32-bit word <targetIndex>
+        auto sourceIt = name_buffer_map.find(source);
+        auto strideIt = buffer_stride_map.find(source);
+        if (sourceIt == name_buffer_map.end() || strideIt == buffer_stride_map.end() || strideIt->second != sizeof(float)) {
+            throw std::runtime_error("source <" + source + "> of reduction pass <" + name + "> is not a std430 F32 storage.");
+        }
+        if (buffer_pair_map.count(source) || buffer_pair_map.count(target)) {
+            throw std::runtime_error("reduction pass <" + name + "> can not use double-buffered storages.");
+        }
+        auto targetIt = name_buffer_map.find(target);
+        if (targetIt == name_buffer_map.end() || !buffer_stride_map.count(target) || (targetIndex + 1) * sizeof(float) > targetIt->second->size) {
+            throw std::runtime_error("target <" + target + "[" + std::to_string(targetIndex) + "]> of reduction pass <" + name + "> is not in a storage.");
+        }
+
+        auto count = static_cast<uint32_t>(sourceIt->second->size / sizeof(float));
+        uint32_t valuesPerGroup = BuiltinShaders::reduceGroupSize * BuiltinShaders::reduceItemsPerInvocation;
+        uint32_t partialCount = std::max<uint32_t>((count + valuesPerGroup - 1) / valuesPerGroup, 1);
+
+        // One partial per workgroup of the first stage
+        auto partials = std::make_shared<Buffer>(device, "Partials of " + name, *allocator, partialCount * sizeof(float),
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        name_buffer_map.emplace(partials->name, partials);
+
+        ShaderDefines defines = { { "SUBGROUP_ARITHMETIC", subgroupArithmetic ? "1" : "0" } };
+        uint32_t ignored = 0;
+        float ignoredValue = reduceInfo.value("ignore", 0.0f);
+        std::memcpy(&ignored, &ignoredValue, sizeof(float));
+        SpecializationConstants partialStage = { {0, 0}, {1, operationIt->second}, {2, count}, {3, 0}, {4, reduceInfo.contains("ignore") ? 1u : 0u}, {5, ignored} };
+        SpecializationConstants finalStage = { {0, 1}, {1, operationIt->second}, {2, partialCount}, {3, targetIndex}, {4, 0}, {5, 0} };
+
+        auto createStage = [this, defines](std::string shader, SpecializationConstants specialization) {
+            return std::make_shared<ComputePipeline>(device, shader.c_str(), BuiltinShaders::reduce, pipelineCache, defines, specialization);
+        };
+        return {
+                pool.submit([createStage, name, partialStage] { return createStage("__REDUCE__" + name, partialStage); }),
+                pool.submit([createStage, name, finalStage] { return createStage("__REDUCE_FINAL__" + name, finalStage); })
+        };
+    }
+
+    void Core::bindReduction(const Json& passInfo) {
+
+        std::string name = passInfo["name"];
+        std::string finalName = name + "/final";
+        const auto& reduceInfo = passInfo["reduce"];
+        auto source = name_buffer_map[reduceInfo["source"].get<std::string>()].get();
+        auto target = name_buffer_map[reduceInfo["target"].get<std::string>()].get();
+        auto partials = name_buffer_map["Partials of " + name].get();
+
+        // [ source -> partials ], then [ partials -> target ], bound directly like the guard (not part of the descriptor set pool)
+        std::array<std::pair<ComputePipeline*, std::array<Buffer*, 2>>, 2> stages = {{
+                { name_pipeline_map["__REDUCE__" + name].get(), { source, partials } },
+                { name_pipeline_map["__REDUCE_FINAL__" + name].get(), { partials, target } }
+        }};
+        for (const auto& [pipeline, resources] : stages) {
+            VkDescriptorSetAllocateInfo allocInfo {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorSetCount = static_cast<uint32_t>(pipeline->descriptorSetLayout.size());
+            allocInfo.pSetLayouts = pipeline->descriptorSetLayout.data();
+            allocInfo.descriptorPool = descriptorPool;
+            if (vkAllocateDescriptorSets(device, &allocInfo, pipeline->descriptorSets.data()) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate descriptor sets for reduction pipeline!");
+            }
+
+            std::array<VkDescriptorBufferInfo, 2> bufferInfos = { resources[0]->getDescriptorBufferInfo(), resources[1]->getDescriptorBufferInfo() };
+            std::array<VkWriteDescriptorSet, 2> writeSets {};
+            for (uint32_t i = 0; i < writeSets.size(); ++i) {
+                writeSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writeSets[i].dstSet = pipeline->descriptorSets[0];
+                writeSets[i].dstBinding = i;
+                writeSets[i].dstArrayElement = 0;
+                writeSets[i].descriptorCount = 1;
+                writeSets[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writeSets[i].pBufferInfo = &bufferInfos[i];
+            }
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeSets.size()), writeSets.data(), 0, nullptr);
+
+            for (size_t i = 0; i < pipeline->bindingResourceInfo.size(); ++i) {
+                pipeline->bindingResources[i] = resources[pipeline->bindingResourceInfo[i][1]];
+            }
+        }
+
+        // Every invocation of the first stage reduces <reduceItemsPerInvocation> values
+        auto valueCount = static_cast<uint32_t>(source->size / sizeof(float));
+        std::array<uint32_t, 3> partialScale = { (valueCount + BuiltinShaders::reduceItemsPerInvocation - 1) / BuiltinShaders::reduceItemsPerInvocation, 1, 1 };
+        std::array<uint32_t, 3> finalScale = { 1, 1, 1 };
+        std::string partialShader = stages[0].first->name;
+        std::string finalShader = stages[1].first->name;
+        auto partialGroups = groupCountsFor(name, stages[0].first, partialScale);
+        name_pass_map.emplace(name, std::make_shared<ComputePass>(name, partialShader, partialScale, partialGroups));
+        name_pass_map.emplace(finalName, std::make_shared<ComputePass>(finalName, finalShader, finalScale, finalScale));
+        pass_stages_map[name] = { name, finalName };
+    }
+
+    void Core::runScript() {
+
+        if (cpuBackend) {
+            cpuBackend->runScript();
+            return;
+        }
+
+        Flag flag {};
+        const auto buffer = name_buffer_map["scalars"];
+        for (const auto& node : flowNode_list) {
+
+            node->tick();
+
+            while(!node->isComplete()) {
+
+                executeNode(node.get());
+
+                buffer->readFlag(flag, 0);
+                std::cout << "Dt: " << flag.f << std::endl;
+            }
+        }
+
+        // Wait for end
+        idle();
+    }
+
+    void Core::executeNode(ICommandNode* node, size_t iterations) {
+
+        preheat();
+        submit(recordNode(node, iterations));
+        flip(node, iterations);
+    }
+
+    VkCommandBuffer Core::recordNode(ICommandNode* node, size_t iterations, size_t frame) {
+        HYDRO_TRACE_SCOPE("recordNode");
+
+        // Passes of the node changed, recordings (and the guard commands) are outdated
+        if (node->dirty) {
+            releaseRecordings(node);
+            if (node->nodeType() == 0b11) updateGuard(static_cast<PollableCommandNode*>(node));
+            node->dirty = false;
+        }
+
+        // Resource uploads are batched until something is about to run
+        uploader->flush();
+
+        // Nodes binding double-buffered storages are recorded for both parities they can start with
+        node->flipping = std::any_of(node->passes.begin(), node->passes.end(), [this](const std::shared_ptr<ComputePass>& pass) {
+            return name_pipeline_map[pass->shader]->flips();
+        });
+        size_t parity = node->flipping ? pingPongParity : 0;
+
+        auto key = std::make_tuple(iterations, frame, parity);
+        auto it = node->recordedCommandBuffers.find(key);
+        if (it != node->recordedCommandBuffers.end()) return it->second;
+
+        // Blind steps resubmit their recording while the previous submission of it may still be pending
+        // (frames in flight wait for their slot before reusing its recording)
+        bool blind = frame > 0 && !framesInFlight;
+        auto commandBuffer = commandBegin(blind ? VkCommandBufferUsageFlags(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT) : VkCommandBufferUsageFlags(0));
+        BarrierTracker tracker(serializedExecution);
+        tracker.begin(commandBuffer);
+
+        // Two timestamps for every pass and guard dispatch of the recording
+        if (profiler) profiler->beginRecording(commandBuffer, iterations * (node->passes.size() + 1));
+
+        // Iterations after the first one are guarded, since the host only checks the node after the whole batch
+        // Frames in flight are submitted before the host checks the previous frame, so all of their iterations are guarded
+        // (their first iteration by the priming guard, which lets the very first iteration of the node proceed unchecked)
+        for (size_t i = 0; i < iterations; ++i) {
+            recordIteration(commandBuffer, tracker, node, frame > 0 || i > 0, frame > 0 && i == 0, node->flipping ? (parity + i) % 2 : 0);
+        }
+        node->postProcess(commandBuffer, frame > 0 ? frame - 1 : 0);
+
+        commandEnd(commandBuffer);
+        node->recordedCommandBuffers.emplace(key, commandBuffer);
+        return commandBuffer;
+    }
+
+    void Core::releaseRecordings(ICommandNode* node) {
+
+        for (const auto& recording : node->recordedCommandBuffers) {
+            if (profiler) profiler->release(recording.second);
+            vkFreeCommandBuffers(device, commandPool, 1, &recording.second);
+            commandBuffers.erase(std::remove(commandBuffers.begin(), commandBuffers.end(), recording.second), commandBuffers.end());
+        }
+        node->recordedCommandBuffers.clear();
+    }
+
+    void Core::flip(ICommandNode* node, size_t iterations) {
+
+        // Every submitted iteration swaps the buffers of double-buffered storages
+        // (iterations masked by a guard are taken back by settleParity once the node is complete)
+        if (node->flipping) pingPongParity = static_cast<uint32_t>((pingPongParity + iterations) % 2);
+
+        // Guards of later submissions check the condition from their first iteration on
+        if (node->nodeType() == 0b11) static_cast<PollableCommandNode*>(node)->submitted = true;
+    }
+
+    void Core::settleParity(PollableCommandNode* node) {
+
+        // Masked iterations swapped nothing on the device, the guard counted them in the control buffer
+        if (node->flipping) pingPongParity = static_cast<uint32_t>((pingPongParity + node->maskedIterations()) % 2);
+    }
+
+    Buffer* Core::currentBuffer(const std::string& name) const {
+
+        auto pairIt = buffer_pair_map.find(name);
+        const auto& bufferName = pairIt != buffer_pair_map.end() && pingPongParity ? pairIt->second : name;
+        auto bufferIt = name_buffer_map.find(bufferName);
+        return bufferIt != name_buffer_map.end() ? bufferIt->second.get() : nullptr;
+    }
+
+    void Core::recordIteration(const VkCommandBuffer& commandBuffer, BarrierTracker& tracker, ICommandNode* node, bool guarded, bool priming, size_t parity) {
+
+        PollableCommandNode* pollableNode = nullptr;
+        if (guarded && node->nodeType() == 0b11) {
+            pollableNode = static_cast<PollableCommandNode*>(node);
+
+            // Evaluate termination condition, writing indirect commands of the passes
+            const auto& guardPass = priming ? pollableNode->primingGuardPass : pollableNode->guardPass;
+            const auto guardPipeline = name_pipeline_map[guardPass->shader].get();
+            tracker.synchronize(commandBuffer, getPipelineAccesses(guardPipeline));
+            if (profiler) profiler->beginDispatch(commandBuffer, guardPass->name);
+            Core::dispatch(commandBuffer, guardPipeline, guardPass->groupCounts);
+            if (profiler) profiler->endDispatch(commandBuffer);
+        }
+
+        // Barriers between passes are inferred from the reflected binding access of their pipelines
+        for (size_t i = 0; i < node->passes.size(); ++i) {
+            const auto& pass = node->passes[i];
+            const auto pipeline = name_pipeline_map[pass->shader].get();
+            auto accesses = getPipelineAccesses(pipeline, parity);
+
+            if (pollableNode) {
+                accesses.push_back({ pollableNode->controlBuffer.get(), VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT });
+                tracker.synchronize(commandBuffer, accesses);
+                if (profiler) profiler->beginDispatch(commandBuffer, pass->name);
+                Core::dispatchIndirect(commandBuffer, pipeline, pollableNode->controlBuffer->buffer, pollableNode->commandOffset(i), parity);
+            } else {
+                tracker.synchronize(commandBuffer, accesses);
+                if (profiler) profiler->beginDispatch(commandBuffer, pass->name);
+                Core::dispatch(commandBuffer, pipeline, pass->groupCounts, parity);
+            }
+            if (profiler) profiler->endDispatch(commandBuffer);
+        }
+    }
+
+    void Core::setProfiling(bool enabled, bool pipelineStatistics) {
+
+        if (cpuBackend) {
+            if (enabled) std::cout << "Pass timestamps are not available on the CPU backend, only host phases are traced." << std::endl;
+            return;
+        }
+        if (!enabled && !profiler) return;
+        if (enabled && !timestampValidBits) {
+            throw std::runtime_error("timestamps are not supported by the compute queue of this device.");
+        }
+        if (enabled && pipelineStatistics && !pipelineStatisticsQuery) {
+            std::cout << "Pipeline statistics queries are not supported on this device, profiling timestamps only." << std::endl;
+            pipelineStatistics = false;
+        }
+
+        // Recordings own the queries, so all of them are rebuilt once no frame is executing
+        idle();
+        for (const auto& node : flowNode_list) {
+            releaseRecordings(node.get());
+        }
+        profiler.reset();
+        if (enabled) profiler = std::make_unique<Profiler>(device, allocator->limits().timestampPeriod, timestampValidBits, pipelineStatistics);
+        if (profiler && Trace::enabled()) calibrateTimestamps();
+    }
+
+    void Core::setTracing(const std::string& path) {
+
+        if (path.empty()) {
+            // Only the trace this core started is stopped, a trace of another core keeps running
+            if (traceSession) {
+                if (profiler) profiler->collect();
+                Trace::stop(traceSession);
+            }
+            traceSession = 0;
+            return;
+        }
+
+        // GPU passes come from the timestamp queries of the profiler (passes on the host are host phases)
+        traceSession = Trace::start(path);
+        if (cpuBackend) return;
+        if (!profiler) setProfiling(true);
+        calibrateTimestamps();
+    }
+
+    void Core::flushTrace() {
+
+        if (!Trace::enabled()) return;
+
+        // Recalibrate, so that drift between the clocks does not accumulate over long runs
+        if (profiler) {
+            profiler->collect();
+            calibrateTimestamps();
+        }
+        Trace::flush();
+    }
+
+    void Core::calibrateTimestamps() {
+
+        if (!profiler) return;
+
+        VkCalibratedTimestampInfoEXT timestampInfos[2] {};
+        timestampInfos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        timestampInfos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+        timestampInfos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        timestampInfos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+        uint64_t timestamps[2] = {};
+        uint64_t maxDeviation = 0;
+        if (getCalibratedTimestamps && monotonicTimeDomain) {
+            if (getCalibratedTimestamps(device, 2, timestampInfos, timestamps, &maxDeviation) == VK_SUCCESS) {
+                profiler->calibrate(timestamps[0], timestamps[1]);
+                return;
+            }
+        }
+
+        // Device clock only, the host time is the middle of the call
+        if (getCalibratedTimestamps) {
+            auto before = Trace::now();
+            if (getCalibratedTimestamps(device, 1, timestampInfos, timestamps, &maxDeviation) == VK_SUCCESS) {
+                profiler->calibrate(timestamps[0], before + (Trace::now() - before) / 2);
+                return;
+            }
+        }
+
+        // Without the extension a timestamp is written by a one-off submission, its host time is read when the queue
+        // is idle again (late by the latency of the submission)
+        VkQueryPoolCreateInfo queryPoolInfo {};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 1;
+        VkQueryPool queryPool;
+        if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create calibration query pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate calibration command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, 1);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 0);
+        commandEnd(commandBuffer);
+
+        VkSubmitInfo submitInfo {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.commandBufferCount = 1;
+        if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit calibration command buffer!");
+        }
+        vkQueueWaitIdle(computeQueue);
+        auto hostNs = Trace::now();
+
+        vkGetQueryPoolResults(device, queryPool, 0, 1, sizeof(uint64_t), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        profiler->calibrate(timestamps[0], hostNs);
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+        vkDestroyQueryPool(device, queryPool, nullptr);
+    }
+
+    std::vector<PassStatistics> Core::profile() {
+
+        if (!profiler) return {};
+        profiler->collect();
+        return profiler->statistics();
+    }
+
+    void Core::setSerializedExecution(bool serialized) {
+
+        // Recordings hold the barriers, so all of them have to be rebuilt
+        serializedExecution = serialized;
+        for (const auto& node : flowNode_list) {
+            releaseRecordings(node.get());
+        }
+    }
+
+    void Core::setFramesInFlight(uint32_t frames) {
+
+        // Steps on the host are complete when they return
+        if (cpuBackend) return;
+
+        // Finish all frames of the previous mode, flag slots and recordings are rebuilt for the new count
+        waitTimeline(timelineValue);
+        framesInFlight = frames;
+        frameIndex = 0;
+        frameTimelineValues.assign(frames, timelineValue);
+
+        for (const auto& node : flowNode_list) {
+            releaseRecordings(node.get());
+            if (node->nodeType() == 0b11) {
+                auto pollableNode = static_cast<PollableCommandNode*>(node.get());
+                createReadback(pollableNode, frames);
+                pollableNode->readFrame(0);
+            }
+        }
+    }
+
+    void Core::setPollInterval(uint32_t interval) {
+
+        for (const auto& node : flowNode_list) {
+            if (node->nodeType() == 0b11) {
+                auto pollableNode = static_cast<PollableCommandNode*>(node.get());
+                pollableNode->pollInterval = std::max<uint32_t>(interval, 1);
+                pollableNode->stepsSincePoll = 0;
+            }
+        }
+    }
+
+    void Core::setShaderCacheDirectory(const std::string& directory) {
+
+        ShaderCache::setDirectory(directory);
+    }
+
+    void Core::setAutotune(bool enabled, uint32_t repetitions) {
+
+        autotuneEnabled = enabled;
+        autotuneRepetitions = std::max<uint32_t>(repetitions, 1);
+    }
+
+    void Core::setTuningDatabase(const std::string& path) {
+
+        tuningDatabasePath = path;
+    }
+
+    // ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Autotuning ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    fs::path Core::tuningDatabaseFile() const {
+
+        if (!tuningDatabasePath.empty()) return tuningDatabasePath;
+        if (ShaderCache::directory().empty()) return {};
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        std::stringstream name;
+        name << "tuning-" << std::hex << properties.vendorID << "-" << properties.deviceID << "-" << properties.driverVersion << ".json";
+        return ShaderCache::directory() / name.str();
+    }
+
+    void Core::loadTuningDatabase() {
+
+        tuningDatabase = Json::object();
+        auto path = tuningDatabaseFile();
+        std::ifstream file(path);
+        if (path.empty() || !file.is_open()) return;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        // Tuned values of other devices or drivers are not used
+        Json database = Json::parse(file, nullptr, false);
+        if (database.is_discarded() || database.value("vendorID", 0u) != properties.vendorID
+            || database.value("deviceID", 0u) != properties.deviceID || database.value("driverVersion", 0u) != properties.driverVersion) {
+            std::cerr << "Tuning database <" << path.string() << "> does not belong to this device, it is ignored." << std::endl;
+            return;
+        }
+        tuningDatabase = std::move(database);
+    }
+
+    void Core::saveTuningDatabase() const {
+
+        auto path = tuningDatabaseFile();
+        if (path.empty()) return;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+        Json database = tuningDatabase;
+        database["device"] = properties.deviceName;
+        database["vendorID"] = properties.vendorID;
+        database["deviceID"] = properties.deviceID;
+        database["driverVersion"] = properties.driverVersion;
+
+        // Written to a unique temporary file first (like shader cache entries), so that a crash or a concurrent run
+        // on the same device never leaves a truncated database behind
+        std::error_code error;
+        if (path.has_parent_path()) fs::create_directories(path.parent_path(), error);
+        auto tempPath = fs::path(path).concat("." + std::to_string(std::random_device{}()) + ".tmp");
+        {
+            std::ofstream file(tempPath, std::ios::trunc);
+            if (file.is_open()) file << database.dump(4) << std::endl;
+            if (!file) {
+                std::cerr << "Failed to write tuning database: " << path.string() << std::endl;
+                file.close();
+                fs::remove(tempPath, error);
+                return;
+            }
+        }
+        fs::rename(tempPath, path, error);
+        if (error) {
+            std::cerr << "Failed to write tuning database: " << path.string() << std::endl;
+            fs::remove(tempPath, error);
+        }
+    }
+
+    std::vector<std::pair<SpecializationConstants, uint32_t>> Core::tuningCandidates(const ComputePipeline* pipeline, const std::array<uint32_t, 3>& computeScale) const {
+
+        // Powers of two for every dimension given by a specialization constant, no larger than the compute scale needs
+        const auto& limits = allocator->limits();
+        const auto& workgroupSize = pipeline->computeShaderModule->workgroupSize;
+        std::array<std::vector<uint32_t>, 3> sizes;
+        for (size_t d = 0; d < 3; ++d) {
+            if (workgroupSize.specIds[d] < 0) {
+                sizes[d] = { pipeline->localSize[d] };
+                continue;
+            }
+            for (uint32_t size = 1; size <= limits.maxComputeWorkGroupSize[d]; size *= 2) {
+                sizes[d].push_back(size);
+                if (size >= computeScale[d]) break;
+            }
+        }
+
+        // Subgroup sizes the device can be asked for, 0 leaves the choice to the driver
+        std::vector<uint32_t> subgroupSizes = { 0 };
+        if (subgroupSizeControl && minSubgroupSize < maxSubgroupSize) {
+            for (uint32_t size = minSubgroupSize; size <= maxSubgroupSize; size *= 2) {
+                subgroupSizes.push_back(size);
+            }
+        }
+
+        // Workgroups smaller than 32 invocations underuse every device, unless the compute scale is that small
+        uint64_t scale = static_cast<uint64_t>(computeScale[0]) * computeScale[1] * computeScale[2];
+        uint64_t minInvocations = std::min<uint64_t>(32, std::max<uint64_t>(scale, 1));
+
+        std::vector<std::pair<SpecializationConstants, uint32_t>> candidates;
+        for (auto x : sizes[0]) {
+            for (auto y : sizes[1]) {
+                for (auto z : sizes[2]) {
+                    uint64_t invocations = static_cast<uint64_t>(x) * y * z;
+                    if (invocations > limits.maxComputeWorkGroupInvocations || invocations < minInvocations) continue;
+
+                    SpecializationConstants specialization;
+                    std::array<uint32_t, 3> size = { x, y, z };
+                    for (size_t d = 0; d < 3; ++d) {
+                        if (workgroupSize.specIds[d] >= 0) specialization[static_cast<uint32_t>(workgroupSize.specIds[d])] = size[d];
+                    }
+
+                    // Shared memory often grows with the workgroup (e.g. tiles), exceeding it is invalid usage and not an error
+                    // the driver has to report, so such variants are never built
+                    auto variantSpecialization = pipeline->specialization;
+                    for (const auto& [constantId, value] : specialization) variantSpecialization[constantId] = value;
+                    if (reflectSharedMemorySize(pipeline->computeShaderModule->spirvCode, variantSpecialization) > limits.maxComputeSharedMemorySize) continue;
+                    for (auto subgroupSize : subgroupSizes) {
+                        if (subgroupSize && invocations > static_cast<uint64_t>(subgroupSize) * maxComputeWorkgroupSubgroups) continue;
+                        candidates.emplace_back(specialization, subgroupSize);
+                    }
+                }
+            }
+        }
+        return candidates;
+    }
+
+    double Core::timeDispatch(const ComputePipeline* pipeline, const std::array<uint32_t, 3>& groupCounts, uint32_t repetitions, VkQueryPool queryPool) const {
+
+        VkCommandBufferAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate autotune command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        // One warm-up dispatch, then <repetitions> dispatches ordered like the passes of a step
+        VkAccessFlags shaderAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        if (queryPool != VK_NULL_HANDLE) vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+        dispatch(commandBuffer, pipeline, groupCounts);
+        barrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, shaderAccess);
+        if (queryPool != VK_NULL_HANDLE) vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+        for (uint32_t i = 0; i < repetitions; ++i) {
+            dispatch(commandBuffer, pipeline, groupCounts);
+            barrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, shaderAccess);
+        }
+        if (queryPool != VK_NULL_HANDLE) vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+        commandEnd(commandBuffer);
+
+        VkSubmitInfo submitInfo {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.commandBufferCount = 1;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit autotune command buffer!");
+        }
+        vkQueueWaitIdle(computeQueue);
+        std::chrono::duration<double, std::nano> hostDuration = std::chrono::high_resolution_clock::now() - start;
+        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+
+        // Nanoseconds per dispatch, host time of the submission if the queue has no timestamps
+        if (queryPool == VK_NULL_HANDLE) return hostDuration.count() / repetitions;
+
+        uint64_t timestamps[2] = {};
+        vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        uint64_t mask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+        return static_cast<double>((timestamps[1] - timestamps[0]) & mask) * allocator->limits().timestampPeriod / repetitions;
+    }
+
+    void Core::autotune() {
+        HYDRO_TRACE_SCOPE("autotune");
+
+        // Timestamps are used if the compute queue supports them
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        if (timestampValidBits) {
+            VkQueryPoolCreateInfo queryPoolInfo {};
+            queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryPoolInfo.queryCount = 2;
+            if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create autotune query pool!");
+            }
+        }
+
+        auto releasePipeline = [this](const std::shared_ptr<ComputePipeline>& pipeline) {
+            vkFreeDescriptorSets(device, descriptorPool, static_cast<uint32_t>(pipeline->descriptorSets.size()), pipeline->descriptorSets.data());
+            if (pipeline->flips()) {
+                vkFreeDescriptorSets(device, descriptorPool, static_cast<uint32_t>(pipeline->flippedDescriptorSets.size()), pipeline->flippedDescriptorSets.data());
+            }
+            destroyPipeline(pipeline.get());
+        };
+
+        std::cout << "\n==================== Autotune ====================" << std::endl;
+        ThreadPool pool;
+        auto& tunedPipelines = tuningDatabase["pipelines"];
+        for (auto& pipelineEntry : name_pipeline_map) {
+            const std::string& name = pipelineEntry.first;
+            auto& pipeline = pipelineEntry.second;
+
+            // Built-in pipelines are bound directly and keep their workgroup size
+            if (name.rfind("__", 0) == 0) continue;
+
+            // Representative pass: the largest one dispatching the pipeline
+            std::string passName;
+            std::shared_ptr<ComputePass> pass;
+            for (const auto& [candidatePassName, candidatePass] : name_pass_map) {
+                if (candidatePass->shader != name) continue;
+                const auto& scale = candidatePass->computeScale;
+                if (!pass || uint64_t(scale[0]) * scale[1] * scale[2] > uint64_t(pass->computeScale[0]) * pass->computeScale[1] * pass->computeScale[2]) {
+                    passName = candidatePassName;
+                    pass = candidatePass;
+                }
+            }
+            if (!pass) continue;
+
+            auto candidates = tuningCandidates(pipeline.get(), pass->computeScale);
+            if (candidates.size() < 2) continue;
+
+            // Build variants concurrently, SPIR-V comes from the shader cache and only the specialization differs
+            std::vector<std::future<std::shared_ptr<ComputePipeline>>> variantTasks;
+            for (const auto& [specialization, subgroupSize] : candidates) {
+                auto variantSpecialization = pipeline->specialization;
+                for (const auto& [constantId, value] : specialization) variantSpecialization[constantId] = value;
+                variantTasks.emplace_back(pool.submit([this, base = pipeline, variantSpecialization, subgroupSize = subgroupSize] {
+                    return std::make_shared<ComputePipeline>(device, base->name.c_str(), base->source.c_str(), pipelineCache, base->defines, variantSpecialization, subgroupSize);
+                }));
+            }
+
+            // Keep the resources the pipeline writes, timing must not change the initial state of the simulation
+            std::vector<std::pair<Buffer*, std::unique_ptr<Buffer>>> backups;
+            for (size_t i = 0; i < pipeline->bindingResources.size(); ++i) {
+                auto resource = pipeline->bindingResources[i];
+                if (!resource || !(pipeline->bindingResourceAccess[i] & VK_ACCESS_SHADER_WRITE_BIT)) continue;
+                auto backup = std::make_unique<Buffer>(device, "Autotune Backup of " + resource->name, *allocator, resource->size,
+                                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                copyBuffer(resource->buffer, backup->buffer, resource->size);
+                backups.emplace_back(resource, std::move(backup));
+            }
+
+            // A variant has to beat the pipeline as configured now
+            double bestTime = timeDispatch(pipeline.get(), pass->groupCounts, autotuneRepetitions, queryPool);
+            std::shared_ptr<ComputePipeline> best;
+            std::vector<VkCopyDescriptorSet> bestCopies;
+            for (auto& variantTask : variantTasks) {
+
+                // Drivers may still reject a variant (e.g. a required subgroup size), it is skipped then
+                std::shared_ptr<ComputePipeline> variant;
+                try {
+                    variant = variantTask.get();
+                } catch (const std::exception&) {
+                    continue;
+                }
+
+                auto copies = bindPipeline(variant);
+                vkUpdateDescriptorSets(device, 0, nullptr, static_cast<uint32_t>(copies.size()), copies.data());
+                double time = timeDispatch(variant.get(), groupCountsFor(passName, variant.get(), pass->computeScale), autotuneRepetitions, queryPool);
+                if (time < bestTime) {
+                    if (best) releasePipeline(best);
+                    best = variant;
+                    bestCopies = std::move(copies);
+                    bestTime = time;
+                } else {
+                    releasePipeline(variant);
+                }
+            }
+
+            for (auto& [resource, backup] : backups) {
+                copyBuffer(backup->buffer, resource->buffer, resource->size);
+                backup->release();
+            }
+
+            // Replace the pipeline by the winner, descriptor copies into the sets of the old pipeline are dropped
+            if (best) {
+                auto oldSets = pipeline->descriptorSets;
+                oldSets.insert(oldSets.end(), pipeline->flippedDescriptorSets.begin(), pipeline->flippedDescriptorSets.end());
+                descriptorCopySets.erase(std::remove_if(descriptorCopySets.begin(), descriptorCopySets.end(), [&oldSets](const VkCopyDescriptorSet& copy) {
+                    return std::find(oldSets.begin(), oldSets.end(), copy.dstSet) != oldSets.end();
+                }), descriptorCopySets.end());
+                descriptorCopySets.insert(descriptorCopySets.end(), bestCopies.begin(), bestCopies.end());
+                releasePipeline(pipeline);
+                pipeline = best;
+
+                for (const auto& [usingPassName, usingPass] : name_pass_map) {
+                    if (usingPass->shader == name) usingPass->groupCounts = groupCountsFor(usingPassName, pipeline.get(), usingPass->computeScale);
+                }
+            }
+
+            const auto& localSize = pipeline->localSize;
+            std::cout << "Pipeline <" << name << ">: local size " << localSize[0] << "x" << localSize[1] << "x" << localSize[2]
+                      << ", subgroup size " << (pipeline->requiredSubgroupSize ? std::to_string(pipeline->requiredSubgroupSize) : "default")
+                      << ", " << bestTime / 1000.0 << " us per dispatch (" << candidates.size() << " candidates)" << std::endl;
+
+            Json tuned;
+            tuned["name"] = name;
+            tuned["localSize"] = localSize;
+            tuned["specialization"] = Json::object();
+            for (const auto& [constantId, value] : pipeline->specialization) tuned["specialization"][std::to_string(constantId)] = value;
+            tuned["subgroupSize"] = pipeline->requiredSubgroupSize;
+            tuned["timeUs"] = bestTime / 1000.0;
+            tunedPipelines[pipeline->computeShaderModule->cacheKey] = tuned;
+        }
+
+        if (queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, queryPool, nullptr);
+        updateBindings();
+        saveTuningDatabase();
+    }
 
     void Core::initialization(const std::string& path) {
 
+        initialization(readJsonFile(path));
+    }
+
+    void Core::initialization(const Json& script) {
+
+        if (cpuBackend) {
+            cpuBackend->initialization(script);
+            return;
+        }
+
         // Parse script first
-        parseScript(path);
+        parseScript(script);
 
         // Find，run and remove initialization node
         // Command Node<__INIT__> can be non-unique, but must be ordered
@@ -925,29 +2453,126 @@ namespace NextHydro {
 
     bool Core::step() {
 
-        // Run Command Node<__STEP__>
+        return stepBatch(1);
+    }
+
+    bool Core::stepBatch(uint32_t iterations) {
+
+        if (cpuBackend) return cpuBackend->stepBatch(iterations);
+        if (framesInFlight) return stepAsync(iterations);
+
+        // Run Command Node<__STEP__> for several iterations with one submission per node
         Flag flag {};
-        const auto buffer = name_buffer_map["scalars"];
+        auto scalarsIt = name_buffer_map.find("scalars");
         for (const auto& node : flowNode_list) {
-            executeNode(node.get());
+            auto nodeIterations = node->clampIterations(iterations);
+            if (node->nodeType() == 0b11 && static_cast<PollableCommandNode*>(node.get())->isBlind()) {
+
+                // Recorded like the first frame in flight (all iterations guarded), submitted without waiting
+                submitFrame({ recordNode(node.get(), nodeIterations, 1) }, ++timelineValue);
+                flip(node.get(), nodeIterations);
+                pendingSubmissions = true;
+            } else {
+                executeNode(node.get(), nodeIterations);
+            }
+            if (nodeIterations > 1) node->skip(nodeIterations - 1);
         }
 
-        buffer->readFlag(flag, 0);
-        std::cout << "Dt: " << float(flag.u) / 10000.0 << std::endl;
-
-        // Remove node if it is completed
+        // Remove node if it is completed (checked only once per batch, or once per poll interval for blind nodes)
         flowNode_list.erase(
                 std::remove_if(
                         flowNode_list.begin(),
                         flowNode_list.end(),
-                        [](const auto& node) -> bool {
-                            return node->isComplete();
+                        [this](const auto& node) -> bool {
+                            if (node->nodeType() == 0b11) {
+                                auto pollableNode = static_cast<PollableCommandNode*>(node.get());
+                                if (pollableNode->isBlind() && !pollableNode->pollDue()) return false;
+                            }
+                            if (pendingSubmissions) {
+                                waitTimeline(timelineValue);
+                                pendingSubmissions = false;
+                            }
+                            if (!node->isComplete()) return false;
+                            if (node->nodeType() == 0b11) settleParity(static_cast<PollableCommandNode*>(node.get()));
+                            return true;
                         }
                 ),
                 flowNode_list.end()
         );
 
+        // Scalars (of scripts having them) are only read once the device caught up with blind submissions
+        if (!pendingSubmissions && scalarsIt != name_buffer_map.end()) {
+            scalarsIt->second->readFlag(flag, 0);
+            std::cout << "Dt: " << flag.f << std::endl;
+        }
+
         // Return false if no node exists
         return !flowNode_list.empty();
     }
-}
\ No newline at end of file
+
+    bool Core::stepAsync(uint32_t iterations) {
+
+        // The frame previously submitted in this slot must be finished before its recordings and flag slot are reused
+        auto slot = static_cast<size_t>(frameIndex % framesInFlight);
+        waitTimeline(frameTimelineValues[slot]);
+
+        // Pollable nodes are checked with the flag of that frame (framesInFlight frames old),
+        // iterations submitted after it are masked on the device by the guard once the condition fails
+        if (frameIndex >= framesInFlight) {
+            flowNode_list.erase(
+                    std::remove_if(
+                            flowNode_list.begin(),
+                            flowNode_list.end(),
+                            [this, slot](const auto& node) -> bool {
+                                if (node->nodeType() != 0b11) return false;
+                                auto pollableNode = static_cast<PollableCommandNode*>(node.get());
+                                if (!pollableNode->pollDue()) return false;
+                                pollableNode->readFrame(slot);
+                                if (!node->isComplete()) return false;
+
+                                // Later frames of the node are still in flight, all of them are masked
+                                if (node->flipping) {
+                                    waitTimeline(timelineValue);
+                                    settleParity(pollableNode);
+                                }
+                                return true;
+                            }
+                    ),
+                    flowNode_list.end()
+            );
+        }
+
+        // Submit all nodes as one frame without waiting for it
+        if (!flowNode_list.empty()) {
+            std::vector<VkCommandBuffer> frameCommandBuffers;
+            for (const auto& node : flowNode_list) {
+                auto nodeIterations = node->clampIterations(iterations);
+                frameCommandBuffers.emplace_back(recordNode(node.get(), nodeIterations, slot + 1));
+                flip(node.get(), nodeIterations);
+                if (nodeIterations > 1) node->skip(nodeIterations - 1);
+            }
+            frameTimelineValues[slot] = ++timelineValue;
+            submitFrame(frameCommandBuffers, timelineValue);
+            ++frameIndex;
+        }
+
+        // Iterable nodes are counted on the host and need no readback
+        flowNode_list.erase(
+                std::remove_if(
+                        flowNode_list.begin(),
+                        flowNode_list.end(),
+                        [](const auto& node) -> bool {
+                            return node->nodeType() == 0b01 && node->isComplete();
+                        }
+                ),
+                flowNode_list.end()
+        );
+
+        // Drain frames in flight before reporting the end, so that buffers hold the final state
+        if (flowNode_list.empty()) {
+            waitTimeline(timelineValue);
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,363 @@
+//
+// Created by Yucheng Soku on 2024/11/30.
+//
+
+#include <cstring>
+#include <limits>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include "HydroCore/Block.h"
+#include "HydroCore/Trace.h"
+#include "HydroCore/CpuKernels.h"
+#include "HydroCore/CpuBackend.h"
+
+namespace NextHydro {
+
+    namespace {
+
+        // Words of a block as Core would upload them (fill patterns are repeated over the whole block)
+        std::vector<uint32_t> wordsOf(const Block& block) {
+
+            std::vector<uint32_t> words((block.size + sizeof(uint32_t) - 1) / sizeof(uint32_t), block.fillPattern);
+            if (block.buffer) std::memcpy(words.data(), block.buffer.get(), block.size);
+            return words;
+        }
+
+        // Preprocessor definition of a pipeline, e.g. "defines": { "FUSED_CFL": 1 }
+        bool defined(const Json& defines, const std::string& macro) {
+
+            auto it = defines.find(macro);
+            if (it == defines.end()) return false;
+            if (it->is_boolean()) return it->get<bool>();
+            if (it->is_number()) return it->get<double>() != 0.0;
+            return it->is_string() && it->get<std::string>() != "0";
+        }
+
+        template<typename T>
+        T* bound(CpuBackend& backend, const std::string& name) {
+
+            return backend.name_storage_map.count(name) ? backend.storage<T>(name) : nullptr;
+        }
+
+        // Scripts without the rows of a strip run the whole grid
+        CpuKernels::Constants constantsOf(CpuBackend& backend) {
+
+            CpuKernels::Constants constants;
+            size_t size = std::min(sizeof(constants), backend.storageSize("constants") * sizeof(uint32_t));
+            std::memcpy(static_cast<void*>(&constants), backend.storage<uint32_t>("constants"), size);
+            if (size < sizeof(constants)) {
+                constants.row_offset = 0;
+                constants.row_count = constants.res_y + 1;
+                constants.owned_begin = 0;
+                constants.owned_end = constants.res_y + 1;
+            }
+            return constants;
+        }
+
+        CpuKernels::Fields fieldsOf(CpuBackend& backend) {
+
+            CpuKernels::Fields fields;
+            fields.q_x = bound<float>(backend, "q_x");
+            fields.q_y = bound<float>(backend, "q_y");
+            fields.qn_x = bound<float>(backend, "qn_x");
+            fields.qn_y = bound<float>(backend, "qn_y");
+            fields.h = bound<float>(backend, "h");
+            fields.hn = bound<float>(backend, "hn");
+            fields.z = bound<uint32_t>(backend, "z");
+            fields.id_dx = bound<uint32_t>(backend, "id_dx");
+            fields.id_dy = bound<uint32_t>(backend, "id_dy");
+            return fields;
+        }
+
+        // Several chunks per thread, so that stealing can even out rows of different cost
+        size_t rowGrain(const CpuBackend& backend, uint32_t rows) {
+
+            return std::max<size_t>(rows / ((backend.pool.size() + 1) * 8), 1);
+        }
+    }
+
+    // CpuBackend ///////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    CpuBackend::CpuBackend(size_t threadCount)
+            : pool(std::max<size_t>(threadCount, 2) - 1)
+    {
+        registerShallowWaterKernels();
+    }
+
+    void CpuBackend::registerKernel(const std::string& pipeline, CpuKernel kernel) {
+
+        m_kernels[pipeline] = std::move(kernel);
+    }
+
+    void CpuBackend::registerShallowWaterKernels() {
+
+        registerKernel("init", { { "q_x", "q_y", "qn_x", "qn_y", "h", "id_dx", "id_dy", "constants" }, [](CpuBackend& backend, const std::string&) {
+            auto constants = constantsOf(backend);
+            auto fields = fieldsOf(backend);
+            backend.pool.parallelFor(0, constants.row_count, rowGrain(backend, constants.row_count), [&](size_t begin, size_t end) {
+                CpuKernels::initRows(constants, fields, static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+            });
+            CpuKernels::initMasks(constants, fields);
+        }});
+
+        registerKernel("updateBoundaryHeight", { { "h", "hn", "constants" }, [](CpuBackend& backend, const std::string&) {
+            CpuKernels::boundaryHeight(constantsOf(backend), fieldsOf(backend));
+        }});
+
+        registerKernel("updateFlow", { { "z", "q_x", "q_y", "qn_x", "qn_y", "hn", "id_dx", "id_dy", "constants", "scalars" }, [](CpuBackend& backend, const std::string& pipeline) {
+            auto constants = constantsOf(backend);
+            auto fields = fieldsOf(backend);
+            float dt = backend.storage<float>("scalars")[0];
+
+            // Fused CFL writes one partial per row into <dtPartials> instead of the timestep of every cell into <dt3>
+            float* rowDt = nullptr;
+            float* dt3 = nullptr;
+            if (defined(backend.pipeline_defines_map[pipeline], "FUSED_CFL")) {
+                if (backend.storageSize("dtPartials") < constants.row_count) {
+                    throw std::runtime_error("storage <dtPartials> holds less partials than the grid has rows!");
+                }
+                rowDt = backend.storage<float>("dtPartials");
+            } else {
+                dt3 = backend.storage<float>("dt3");
+            }
+            backend.pool.parallelFor(0, constants.row_count, rowGrain(backend, constants.row_count), [&](size_t begin, size_t end) {
+                CpuKernels::flowRows(constants, fields, dt, static_cast<uint32_t>(begin), static_cast<uint32_t>(end), rowDt, dt3);
+            });
+        }});
+
+        registerKernel("updateHeight", { { "q_x", "q_y", "h", "hn", "constants", "scalars" }, [](CpuBackend& backend, const std::string&) {
+            auto constants = constantsOf(backend);
+            auto fields = fieldsOf(backend);
+            float dt = backend.storage<float>("scalars")[0];
+
+            CpuKernels::heightBoundary(constants, fields);
+            backend.pool.parallelFor(0, constants.row_count, rowGrain(backend, constants.row_count), [&](size_t begin, size_t end) {
+                CpuKernels::heightRows(constants, fields, dt, static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+            });
+        }});
+
+        registerKernel("updateTotalTime", { { "scalars" }, [](CpuBackend& backend, const std::string&) {
+            auto scalars = backend.storage<float>("scalars");
+            scalars[2] += scalars[0];
+        }});
+    }
+
+    void CpuBackend::parseScript(const Json& script) {
+        HYDRO_TRACE_SCOPE("parseScript");
+
+        m_nodes.clear();
+        m_pass_shader_map.clear();
+        m_pass_reduction_map.clear();
+        name_storage_map.clear();
+        storage_stride_map.clear();
+        storage_pair_map.clear();
+        pipeline_defines_map.clear();
+        pingPongParity = 0;
+
+        // Storages (transient ones are ordinary storages on the host) and uniforms share one namespace
+        std::string defaultPacking = script.value("packing", "std140");
+        for (const auto& storageInfo : script["storages"]) {
+            std::string name = storageInfo["name"];
+            Block block(storageInfo["layout"], storageInfo["resource"], parsePacking(storageInfo.value("packing", defaultPacking)));
+            name_storage_map[name] = wordsOf(block);
+            storage_stride_map[name] = block.stride;
+
+            if (storageInfo.value("doubleBuffered", false)) {
+                std::string previous = storageInfo.value("previous", name + "_prev");
+                name_storage_map[previous] = name_storage_map[name];
+                storage_stride_map[previous] = block.stride;
+                storage_pair_map.emplace(name, previous);
+                storage_pair_map.emplace(previous, name);
+            }
+        }
+        for (const auto& uniformInfo : script["uniforms"]) {
+            std::string name = uniformInfo["name"];
+            Block block(uniformInfo["layout"], uniformInfo["resource"]);
+            name_storage_map[name] = wordsOf(block);
+            storage_stride_map[name] = block.stride;
+        }
+
+        // Pipelines are run by the kernels registered for their names
+        for (const auto& pipelineInfo : script["pipelines"]) {
+            std::string name = pipelineInfo["name"];
+            if (!m_kernels.count(name)) throw std::runtime_error("no CPU kernel is registered for pipeline <" + name + ">!");
+            pipeline_defines_map[name] = pipelineInfo.value("defines", Json::object());
+        }
+
+        for (const auto& passInfo : script["passes"]) {
+            std::string name = passInfo["name"];
+            if (!passInfo.contains("reduce")) {
+                std::string shader = passInfo["shader"];
+                if (!pipeline_defines_map.count(shader)) throw std::runtime_error("pipeline <" + shader + "> of pass <" + name + "> does not exist!");
+                m_pass_shader_map[name] = shader;
+                continue;
+            }
+
+            const auto& reduceInfo = passInfo["reduce"];
+            Reduction reduction;
+            reduction.source = reduceInfo["source"];
+            reduction.target = reduceInfo["target"];
+            reduction.operation = reduceInfo.value("operation", "min");
+            reduction.targetIndex = reduceInfo.value("targetIndex", 0u);
+            reduction.skipping = reduceInfo.contains("ignore");
+            reduction.ignored = reduceInfo.value("ignore", 0.0f);
+
+            if (reduction.operation != "min" && reduction.operation != "max" && reduction.operation != "sum") {
+                throw std::runtime_error("reduction pass <" + name + "> has unknown operation <" + reduction.operation + ">.");
+            }
+            auto strideIt = storage_stride_map.find(reduction.source);
+            if (strideIt == storage_stride_map.end() || strideIt->second != sizeof(float)) {
+                throw std::runtime_error("source <" + reduction.source + "> of reduction pass <" + name + "> is not a std430 F32 storage.");
+            }
+            if (storage_pair_map.count(reduction.source) || storage_pair_map.count(reduction.target)) {
+                throw std::runtime_error("reduction pass <" + name + "> can not use double-buffered storages.");
+            }
+            if (!name_storage_map.count(reduction.target) || reduction.targetIndex >= storageSize(reduction.target)) {
+                throw std::runtime_error("target <" + reduction.target + "[" + std::to_string(reduction.targetIndex) + "]> of reduction pass <" + name + "> is not in a storage.");
+            }
+            m_pass_reduction_map[name] = reduction;
+        }
+
+        for (const auto& nodeInfo : script["flow"]) {
+            Node node;
+            node.name = nodeInfo["nodeName"];
+            node.passes = nodeInfo["passes"].get<std::vector<std::string>>();
+            node.type = nodeInfo["type"].get<size_t>();
+            if (node.type == 0b01) {
+                node.count = nodeInfo["count"];
+            } else if (node.type == 0b11) {
+                node.flagStorage = nodeInfo["flagBuffer"];
+                node.flagIndex = nodeInfo["flagIndex"];
+                node.operation = nodeInfo["operation"];
+                node.flag = nodeInfo["flag"];
+                if (storage_pair_map.count(node.flagStorage)) {
+                    throw std::runtime_error("flag buffer of node <" + node.name + "> can not be double-buffered.");
+                }
+            } else {
+                continue;
+            }
+
+            // Nodes binding double-buffered storages swap them after every iteration
+            node.flipping = std::any_of(node.passes.begin(), node.passes.end(), [this](const std::string& passName) {
+                auto shaderIt = m_pass_shader_map.find(passName);
+                if (shaderIt == m_pass_shader_map.end()) return false;
+                const auto& bindings = m_kernels[shaderIt->second].bindings;
+                return std::any_of(bindings.begin(), bindings.end(), [this](const std::string& binding) { return storage_pair_map.count(binding) > 0; });
+            });
+            m_nodes.emplace_back(std::move(node));
+        }
+    }
+
+    void CpuBackend::runScript() {
+
+        for (auto& node : m_nodes) {
+            while (!isComplete(node)) {
+                runNode(node, 1);
+            }
+        }
+    }
+
+    void CpuBackend::initialization(const Json& script) {
+
+        parseScript(script);
+
+        // Command Node<__INIT__> can be non-unique, but must be ordered
+        for (auto& node : m_nodes) {
+            if (node.name == "__INIT__") runNode(node, 1);
+        }
+        m_nodes.erase(std::remove_if(m_nodes.begin(), m_nodes.end(), [](const Node& node) { return node.name == "__INIT__"; }), m_nodes.end());
+    }
+
+    bool CpuBackend::stepBatch(uint32_t iterations) {
+
+        // Iterable nodes run at most as often as they would on the device, pollable ones stop once their condition fails
+        for (auto& node : m_nodes) {
+            size_t nodeIterations = node.type == 0b01 ? std::min<size_t>(iterations, node.count + 2 - node.currentFrame) : iterations;
+            runNode(node, nodeIterations);
+            if (node.type == 0b01 && nodeIterations > 1) node.currentFrame += nodeIterations - 1;
+        }
+
+        // Remove node if it is completed
+        m_nodes.erase(std::remove_if(m_nodes.begin(), m_nodes.end(), [this](Node& node) { return isComplete(node); }), m_nodes.end());
+
+        // Return false if no node exists
+        return !m_nodes.empty();
+    }
+
+    void CpuBackend::reportMemory() const {
+
+        size_t bytes = 0;
+        for (const auto& storage : name_storage_map) {
+            bytes += storage.second.size() * sizeof(uint32_t);
+        }
+        std::cout << "==================== Host Memory ====================" << std::endl;
+        std::cout << "Storages and uniforms: " << name_storage_map.size() << ", " << static_cast<double>(bytes) / (1024.0 * 1024.0) << " MiB" << std::endl;
+        std::cout << "Threads: " << pool.size() + 1 << ", instruction set: " << CpuKernels::instructionSet() << std::endl;
+    }
+
+    size_t CpuBackend::storageSize(const std::string& name) const {
+
+        auto storageIt = name_storage_map.find(name);
+        if (storageIt == name_storage_map.end()) throw std::runtime_error("storage <" + name + "> does not exist!");
+        return storageIt->second.size();
+    }
+
+    void CpuBackend::runNode(Node& node, size_t iterations) {
+        HYDRO_TRACE_SCOPE("runNode");
+
+        for (size_t i = 0; i < iterations; ++i) {
+
+            // Like the guards of Core: the first iteration of a batch follows a check on the host (or is the first one of the node),
+            // every later one checks the condition
+            if (i > 0 && node.type == 0b11 && isComplete(node)) break;
+
+            for (const auto& passName : node.passes) {
+                runPass(passName);
+            }
+            if (node.flipping) pingPongParity ^= 1u;
+        }
+    }
+
+    void CpuBackend::runPass(const std::string& passName) {
+        HYDRO_TRACE_SCOPE(passName.c_str());
+
+        auto reductionIt = m_pass_reduction_map.find(passName);
+        if (reductionIt != m_pass_reduction_map.end()) {
+            reduce(reductionIt->second);
+            return;
+        }
+        const auto& shader = m_pass_shader_map.at(passName);
+        m_kernels.at(shader).run(*this, shader);
+    }
+
+    void CpuBackend::reduce(const Reduction& reduction) {
+
+        // Identities and operations of the reduction shader (see BuiltinShaders::reduce)
+        float value = reduction.operation == "min" ? std::numeric_limits<float>::infinity()
+                    : reduction.operation == "max" ? -std::numeric_limits<float>::infinity()
+                    : 0.0f;
+        const float* values = storage<float>(reduction.source);
+        size_t count = storageSize(reduction.source);
+        for (size_t i = 0; i < count; ++i) {
+            if (reduction.skipping && values[i] == reduction.ignored) continue;
+            if (reduction.operation == "min") value = std::min(value, values[i]);
+            else if (reduction.operation == "max") value = std::max(value, values[i]);
+            else value += values[i];
+        }
+        storage<float>(reduction.target)[reduction.targetIndex] = value;
+    }
+
+    bool CpuBackend::isComplete(Node& node) {
+
+        if (node.type == 0b01) return node.currentFrame++ > node.count;
+
+        // Operations of PollableCommandNode
+        float value = storage<float>(node.flagStorage)[node.flagIndex];
+        if (node.operation == "less") return !(value < node.flag);
+        if (node.operation == "lEqual") return !(value <= node.flag);
+        if (node.operation == "greater") return !(value > node.flag);
+        if (node.operation == "gEqual") return !(value >= node.flag);
+        return !(value == node.flag);
+    }
+}
@@ -0,0 +1,129 @@
+//
+// Created by Yucheng Soku on 2024/11/30.
+//
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "HydroCore/CpuKernels.h"
+
+namespace NextHydro::CpuKernels {
+
+    // Kernels of every instruction set the library is built for (see CMakeLists.txt)
+    namespace Generic { extern const KernelTable kernels; }
+#ifdef HYDROCORE_CPU_DISPATCH
+    namespace Avx2 { extern const KernelTable kernels; }
+    namespace Avx512 { extern const KernelTable kernels; }
+#endif
+
+    namespace {
+
+        inline void clearMask(uint32_t* words, size_t index) {
+            words[index >> 5] &= ~(1u << (index & 31u));
+        }
+
+        // Best first, only those the running CPU supports
+        std::vector<const KernelTable*> supportedKernels() {
+
+            std::vector<const KernelTable*> tables;
+#ifdef HYDROCORE_CPU_DISPATCH
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) tables.push_back(&Avx512::kernels);
+            if (__builtin_cpu_supports("avx2")) tables.push_back(&Avx2::kernels);
+#endif
+            tables.push_back(&Generic::kernels);
+            return tables;
+        }
+
+        const KernelTable*& activeKernels() {
+
+            static const KernelTable* kernels = supportedKernels().front();
+            return kernels;
+        }
+    }
+
+    std::vector<std::string> instructionSets() {
+
+        std::vector<std::string> names;
+        for (const auto table : supportedKernels()) names.emplace_back(table->name);
+        return names;
+    }
+
+    void useInstructionSet(const std::string& name) {
+
+        auto tables = supportedKernels();
+        auto it = std::find_if(tables.begin(), tables.end(), [&name](const KernelTable* table) { return name == table->name; });
+        if (it == tables.end()) throw std::runtime_error("instruction set <" + name + "> is not supported!");
+        activeKernels() = *it;
+    }
+
+    const char* instructionSet() {
+
+        return activeKernels()->name;
+    }
+
+    void initRows(const Constants& c, const Fields& f, uint32_t rowBegin, uint32_t rowEnd) {
+
+        size_t rowLength = c.res_x + 1;
+        for (uint32_t localY = rowBegin; localY < rowEnd; ++localY) {
+            if (localY + c.row_offset >= c.res_y + 1) break;
+
+            size_t base = localY * rowLength;
+            for (float* field : { f.h, f.q_x, f.q_y, f.qn_x, f.qn_y }) {
+                std::fill(field + base, field + base + rowLength, 0.0f);
+            }
+        }
+    }
+
+    void initMasks(const Constants& c, const Fields& f) {
+
+        // Closed boundaries, a word of a mask may hold cells of two rows
+        size_t rowLength = c.res_x + 1;
+        for (uint32_t localY = 0; localY < c.row_count; ++localY) {
+            uint32_t globalY = localY + c.row_offset;
+            if (globalY < 1 || globalY >= c.res_y) continue;
+
+            for (uint32_t x : { 1u, c.res_x }) {
+                size_t index = localY * rowLength + x;
+                clearMask(f.id_dx, index);
+                clearMask(f.id_dy, index);
+            }
+        }
+    }
+
+    void boundaryHeight(const Constants& c, const Fields& f) {
+
+        // Row 0 is held by the first strip only
+        if (c.row_offset != 0) return;
+        for (uint32_t x = 0; x < c.res_x; ++x) {
+            f.h[x] = 2.0f;
+            f.hn[x] = 2.0f;
+        }
+    }
+
+    void heightBoundary(const Constants& c, const Fields& f) {
+
+        size_t rowLength = c.res_x + 1;
+        uint32_t rowEnd = c.row_offset + c.row_count;
+        auto indexOf = [&](uint32_t x, uint32_t y) { return (y - c.row_offset) * rowLength + x; };
+
+        for (uint32_t x = 1; x < c.res_x; ++x) {
+            if (c.res_y - 1 >= c.row_offset) {
+                if (c.res_y < rowEnd) f.q_y[indexOf(x, c.res_y)] = f.q_y[indexOf(x, c.res_y - 1)];
+                if (c.res_y + 1 < rowEnd) f.q_y[indexOf(x, c.res_y + 1)] = f.q_y[indexOf(x, c.res_y - 1)];
+            }
+            if (c.row_offset == 0) f.q_y[indexOf(x, 0)] = f.q_y[indexOf(x, 1)];
+        }
+    }
+
+    void flowRows(const Constants& c, const Fields& f, float dt, uint32_t rowBegin, uint32_t rowEnd, float* rowDt, float* dt3) {
+
+        activeKernels()->flowRows(c, f, dt, rowBegin, rowEnd, rowDt, dt3);
+    }
+
+    void heightRows(const Constants& c, const Fields& f, float dt, uint32_t rowBegin, uint32_t rowEnd) {
+
+        activeKernels()->heightRows(c, f, dt, rowBegin, rowEnd);
+    }
+}
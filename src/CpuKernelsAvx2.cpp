@@ -0,0 +1,11 @@
+//
+// Created by Yucheng Soku on 2024/11/30.
+//
+
+// AVX2 kernels, compiled with the instruction set enabled (see CMakeLists.txt) and used if the CPU supports it
+#ifdef __AVX2__
+#define HYDROCORE_KERNELS_AVX2
+#define HYDROCORE_KERNELS_NAMESPACE Avx2
+namespace NextHydro::CpuKernels::Avx2 { constexpr const char* name = "AVX2"; }
+#include "HydroCore/CpuKernelsImpl.h"
+#endif
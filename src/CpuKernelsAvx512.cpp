@@ -0,0 +1,11 @@
+//
+// Created by Yucheng Soku on 2024/11/30.
+//
+
+// AVX-512 kernels, compiled with the instruction set enabled (see CMakeLists.txt) and used if the CPU supports it
+#ifdef __AVX512F__
+#define HYDROCORE_KERNELS_AVX512
+#define HYDROCORE_KERNELS_NAMESPACE Avx512
+namespace NextHydro::CpuKernels::Avx512 { constexpr const char* name = "AVX-512"; }
+#include "HydroCore/CpuKernelsImpl.h"
+#endif
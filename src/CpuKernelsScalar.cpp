@@ -0,0 +1,8 @@
+//
+// Created by Yucheng Soku on 2024/11/30.
+//
+
+// Scalar kernels, the fallback of CPUs without a wider instruction set
+#define HYDROCORE_KERNELS_NAMESPACE Generic
+namespace NextHydro::CpuKernels::Generic { constexpr const char* name = "scalar"; }
+#include "HydroCore/CpuKernelsImpl.h"
@@ -0,0 +1,210 @@
+//
+// Created by Yucheng Soku on 2024/11/28.
+//
+
+#include <algorithm>
+#include <stdexcept>
+#include "HydroCore/Trace.h"
+#include "HydroCore/Profiler.h"
+
+namespace NextHydro {
+
+    // Helpers ////////////////////////////////////////////////////////////////////////////////////////////////////
+    double percentile(std::vector<double> values, double fraction) {
+
+        if (values.empty()) return 0.0;
+        auto index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1) + 0.5);
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+        return values[index];
+    }
+
+    // Profiler ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    Profiler::Profiler(const VkDevice& device, float timestampPeriod, uint32_t timestampValidBits, bool pipelineStatistics, size_t window)
+            : m_device(device), m_timestampPeriod(timestampPeriod), m_pipelineStatistics(pipelineStatistics), m_window(std::max<size_t>(window, 1))
+    {
+        if (!timestampValidBits) throw std::runtime_error("timestamps are not supported by the compute queue!");
+        m_timestampMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+    }
+
+    Profiler::~Profiler() {
+
+        for (auto& querySet : m_querySets) {
+            vkDestroyQueryPool(m_device, querySet.second.timestampPool, nullptr);
+            vkDestroyQueryPool(m_device, querySet.second.statisticsPool, nullptr);
+        }
+    }
+
+    void Profiler::beginRecording(VkCommandBuffer commandBuffer, size_t maxDispatches) {
+
+        release(commandBuffer);
+        if (!maxDispatches) return;
+
+        QuerySet querySet {};
+        querySet.capacity = static_cast<uint32_t>(maxDispatches);
+
+        VkQueryPoolCreateInfo queryPoolInfo {};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 2 * querySet.capacity;
+        if (vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &querySet.timestampPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool!");
+        }
+
+        if (m_pipelineStatistics) {
+            queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            queryPoolInfo.queryCount = querySet.capacity;
+            queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+            if (vkCreateQueryPool(m_device, &queryPoolInfo, nullptr, &querySet.statisticsPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline statistics query pool!");
+            }
+        }
+        m_querySets.emplace(commandBuffer, std::move(querySet));
+    }
+
+    void Profiler::beginDispatch(VkCommandBuffer commandBuffer, const std::string& pass) {
+
+        auto it = m_querySets.find(commandBuffer);
+        if (it == m_querySets.end()) return;
+        auto& querySet = it->second;
+        if (querySet.passes.size() >= querySet.capacity) throw std::runtime_error("profiled recording has more dispatches than expected!");
+
+        // Queries are reset in the command buffer itself, right before they are written
+        auto query = static_cast<uint32_t>(querySet.passes.size());
+        querySet.passes.push_back(pass);
+        vkCmdResetQueryPool(commandBuffer, querySet.timestampPool, 2 * query, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, querySet.timestampPool, 2 * query);
+        if (querySet.statisticsPool != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(commandBuffer, querySet.statisticsPool, query, 1);
+            vkCmdBeginQuery(commandBuffer, querySet.statisticsPool, query, 0);
+        }
+    }
+
+    void Profiler::endDispatch(VkCommandBuffer commandBuffer) {
+
+        auto it = m_querySets.find(commandBuffer);
+        if (it == m_querySets.end() || it->second.passes.empty()) return;
+        auto& querySet = it->second;
+
+        auto query = static_cast<uint32_t>(querySet.passes.size() - 1);
+        if (querySet.statisticsPool != VK_NULL_HANDLE) vkCmdEndQuery(commandBuffer, querySet.statisticsPool, query);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, querySet.timestampPool, 2 * query + 1);
+    }
+
+    void Profiler::release(VkCommandBuffer commandBuffer) {
+
+        auto it = m_querySets.find(commandBuffer);
+        if (it == m_querySets.end()) return;
+
+        // Recordings are released once their submissions completed, take their last results
+        collect(it->second);
+        vkDestroyQueryPool(m_device, it->second.timestampPool, nullptr);
+        vkDestroyQueryPool(m_device, it->second.statisticsPool, nullptr);
+        m_querySets.erase(it);
+    }
+
+    void Profiler::submitted(VkCommandBuffer commandBuffer) {
+
+        auto it = m_querySets.find(commandBuffer);
+        if (it == m_querySets.end()) return;
+
+        // Results not read yet would be overwritten by this submission
+        if (it->second.pending && !collect(it->second)) m_droppedSubmissions++;
+        it->second.pending = true;
+    }
+
+    void Profiler::collect() {
+
+        for (auto& querySet : m_querySets) {
+            collect(querySet.second);
+        }
+    }
+
+    bool Profiler::collect(QuerySet& querySet) {
+
+        if (!querySet.pending) return true;
+        if (querySet.passes.empty()) {
+            querySet.pending = false;
+            return true;
+        }
+
+        // Every result is followed by its availability, VK_NOT_READY means the submission is still executing
+        auto queryCount = static_cast<uint32_t>(querySet.passes.size());
+        std::vector<uint64_t> timestamps(4 * queryCount);
+        if (vkGetQueryPoolResults(m_device, querySet.timestampPool, 0, 2 * queryCount, timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                                  2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) != VK_SUCCESS) {
+            return false;
+        }
+
+        std::vector<uint64_t> invocations;
+        if (querySet.statisticsPool != VK_NULL_HANDLE) {
+            invocations.resize(2 * queryCount);
+            if (vkGetQueryPoolResults(m_device, querySet.statisticsPool, 0, queryCount, invocations.size() * sizeof(uint64_t), invocations.data(),
+                                      2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) != VK_SUCCESS) {
+                return false;
+            }
+        }
+
+        for (uint32_t query = 0; query < queryCount; ++query) {
+            uint64_t begin = timestamps[4 * query];
+            uint64_t end = timestamps[4 * query + 2];
+            double milliseconds = static_cast<double>((end - begin) & m_timestampMask) * m_timestampPeriod * 1e-6;
+
+            auto& samples = m_samples[querySet.passes[query]];
+            samples.count++;
+            samples.totalMs += milliseconds;
+            samples.windowMs.push_back(milliseconds);
+            if (samples.windowMs.size() > m_window) samples.windowMs.pop_front();
+            if (!invocations.empty()) samples.invocations = invocations[2 * query];
+            if (m_calibrated && Trace::enabled()) Trace::device(querySet.passes[query], hostTime(begin), hostTime(end));
+        }
+        querySet.pending = false;
+        return true;
+    }
+
+    void Profiler::calibrate(uint64_t deviceTicks, uint64_t hostNs) {
+
+        m_calibrated = true;
+        m_calibrationTicks = deviceTicks;
+        m_calibrationHostNs = hostNs;
+    }
+
+    uint64_t Profiler::hostTime(uint64_t deviceTicks) const {
+
+        // Timestamps wrap around after their valid bits, the masked difference is the distance from the calibration
+        auto delta = (deviceTicks - m_calibrationTicks) & m_timestampMask;
+        if (delta > (m_timestampMask >> 1)) {
+            return m_calibrationHostNs - static_cast<uint64_t>(static_cast<double>((m_calibrationTicks - deviceTicks) & m_timestampMask) * m_timestampPeriod);
+        }
+        return m_calibrationHostNs + static_cast<uint64_t>(static_cast<double>(delta) * m_timestampPeriod);
+    }
+
+    std::vector<PassStatistics> Profiler::statistics() const {
+
+        std::vector<PassStatistics> result;
+        for (const auto& [pass, samples] : m_samples) {
+            std::vector<double> window(samples.windowMs.begin(), samples.windowMs.end());
+
+            PassStatistics statistics;
+            statistics.pass = pass;
+            statistics.count = samples.count;
+            statistics.totalMs = samples.totalMs;
+            statistics.invocations = samples.invocations;
+            for (auto value : window) statistics.meanMs += value;
+            statistics.meanMs /= static_cast<double>(std::max<size_t>(window.size(), 1));
+            statistics.p50Ms = percentile(window, 0.50);
+            statistics.p99Ms = percentile(window, 0.99);
+            result.push_back(statistics);
+        }
+
+        // Most expensive passes first
+        std::sort(result.begin(), result.end(), [](const PassStatistics& a, const PassStatistics& b) { return a.totalMs > b.totalMs; });
+        return result;
+    }
+
+    void Profiler::reset() {
+
+        m_samples.clear();
+        m_droppedSubmissions = 0;
+    }
+}
@@ -0,0 +1,121 @@
+//
+// Created by Yucheng Soku on 2024/11/26.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <fstream>
+#include <iostream>
+#include "HydroCore/ShaderCache.h"
+
+namespace fs = std::filesystem;
+namespace NextHydro {
+
+    // Helpers ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Bump when the layout of cache entries changes
+    const char* shaderCacheVersion = "1";
+    const uint32_t spirvMagicNumber = 0x07230203;
+
+    // 64-bit FNV-1a, every field is terminated by a 0xff byte (never part of UTF-8 text) so that fields cannot run into each other
+    void fnv1a(uint64_t& hash, const std::string& field) {
+
+        for (unsigned char c : field) {
+            hash ^= c;
+            hash *= 0x100000001b3ull;
+        }
+        hash ^= 0xffu;
+        hash *= 0x100000001b3ull;
+    }
+
+    // ShaderCache ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    fs::path& ShaderCache::directoryStorage() {
+
+        static fs::path directory = [] {
+            if (const char* env = std::getenv("HYDROCORE_SHADER_CACHE")) return fs::path(env);
+
+            std::error_code error;
+            auto temp = fs::temp_directory_path(error);
+            return error ? fs::path() : temp / "HydroCore" / "shader-cache";
+        }();
+        return directory;
+    }
+
+    void ShaderCache::setDirectory(const fs::path& directory) {
+
+        directoryStorage() = directory;
+    }
+
+    const fs::path& ShaderCache::directory() {
+
+        return directoryStorage();
+    }
+
+    std::string ShaderCache::key(const std::string& source, const ShaderDefines& defines, const std::string& signature) {
+
+        uint64_t hash = 0xcbf29ce484222325ull;
+        fnv1a(hash, shaderCacheVersion);
+        fnv1a(hash, signature);
+        for (const auto& [name, value] : defines) {
+            fnv1a(hash, name);
+            fnv1a(hash, value);
+        }
+        fnv1a(hash, source);
+
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+        return text;
+    }
+
+    fs::path ShaderCache::entryPath(const std::string& key, const std::string& variant) {
+
+        return directory() / (key + "." + variant + ".spv");
+    }
+
+    bool ShaderCache::load(const std::string& key, const std::string& variant, std::vector<uint32_t>& spirv) {
+
+        if (directory().empty()) return false;
+
+        std::ifstream file(entryPath(key, variant), std::ios::binary | std::ios::ate);
+        if (!file.is_open()) return false;
+
+        auto size = static_cast<size_t>(file.tellg());
+        if (size < sizeof(uint32_t) || size % sizeof(uint32_t)) return false;
+
+        spirv.resize(size / sizeof(uint32_t));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(spirv.data()), static_cast<std::streamsize>(size)) || spirv[0] != spirvMagicNumber) {
+            spirv.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void ShaderCache::store(const std::string& key, const std::string& variant, const std::vector<uint32_t>& spirv) {
+
+        if (directory().empty() || spirv.empty()) return;
+
+        // A failing cache only costs a recompilation
+        std::error_code error;
+        fs::create_directories(directory(), error);
+        if (error) {
+            std::cerr << "Shader cache is not writable: " << directory() << std::endl;
+            return;
+        }
+
+        // Write to a unique temporary file first, so that concurrent readers never see a partial entry
+        // and concurrent writers of the same entry (threads or processes) never write into the same file
+        auto path = entryPath(key, variant);
+        auto tempPath = fs::path(path).concat("." + std::to_string(std::random_device{}()) + ".tmp");
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) return;
+            file.write(reinterpret_cast<const char*>(spirv.data()), static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+            if (!file) return;
+        }
+        fs::rename(tempPath, path, error);
+        if (error) fs::remove(tempPath, error);
+    }
+}
@@ -0,0 +1,217 @@
+//
+// Created by Yucheng Soku on 2024/11/28.
+//
+
+#include <array>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <utility>
+#include <fstream>
+#include <stdexcept>
+#include "HydroCore/Trace.h"
+#include "nlohmann/json.hpp"
+
+using Json = nlohmann::json;
+
+namespace NextHydro {
+
+    // Helpers ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Process ids of the two timelines in the trace
+    constexpr uint32_t hostProcess = 1;
+    constexpr uint32_t deviceProcess = 2;
+
+    struct TraceEvent {
+        char                            name[64];
+        uint64_t                        beginNs;
+        uint64_t                        endNs;
+        uint32_t                        process;
+    };
+
+    // Written only by the owning thread, events become visible to flush() with <count>
+    struct TraceChunk {
+        std::array<TraceEvent, 1024>    events;
+        std::atomic<size_t>             count   { 0 };
+        std::atomic<TraceChunk*>        next    { nullptr };
+    };
+
+    struct TraceBuffer {
+        uint32_t                        thread;
+        bool                            named   = false;
+        TraceChunk*                     head;           // oldest chunk not flushed yet (flush only)
+        size_t                          flushed = 0;    // events of <head> already flushed (flush only)
+        TraceChunk*                     tail;           // chunk being written (owning thread only)
+
+        explicit TraceBuffer(uint32_t thread) : thread(thread), head(new TraceChunk), tail(head) {}
+
+        ~TraceBuffer() {
+            while (head) delete std::exchange(head, head->next.load());
+        }
+    };
+
+    struct TraceState {
+        std::mutex                                  mutex;
+        std::ofstream                               file;
+        bool                                        firstEvent  = true;
+        uint64_t                                    originNs    = 0;
+        uint64_t                                    session     = 0;
+        std::vector<std::unique_ptr<TraceBuffer>>   buffers;
+    };
+
+    TraceState& traceState() {
+
+        static TraceState state;
+        return state;
+    }
+
+    // Buffers are registered once per thread and outlive it, so events of finished threads are still flushed
+    TraceBuffer& localBuffer() {
+
+        thread_local TraceBuffer* buffer = nullptr;
+        if (!buffer) {
+            auto& state = traceState();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.buffers.push_back(std::make_unique<TraceBuffer>(static_cast<uint32_t>(state.buffers.size())));
+            buffer = state.buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    void append(uint32_t process, const char* name, uint64_t beginNs, uint64_t endNs) {
+
+        auto& buffer = localBuffer();
+        auto count = buffer.tail->count.load(std::memory_order_relaxed);
+        if (count == buffer.tail->events.size()) {
+            auto chunk = new TraceChunk;
+            buffer.tail->next.store(chunk, std::memory_order_release);
+            buffer.tail = chunk;
+            count = 0;
+        }
+
+        auto& event = buffer.tail->events[count];
+        std::strncpy(event.name, name, sizeof(event.name) - 1);
+        event.name[sizeof(event.name) - 1] = '\0';
+        event.beginNs = beginNs;
+        event.endNs = endNs;
+        event.process = process;
+        buffer.tail->count.store(count + 1, std::memory_order_release);
+    }
+
+    void writeEvent(TraceState& state, const Json& event) {
+
+        state.file << (state.firstEvent ? "" : ",\n") << event.dump();
+        state.firstEvent = false;
+    }
+
+    void writeMetadata(TraceState& state, const char* name, uint32_t process, uint32_t thread, const std::string& value) {
+
+        writeEvent(state, { {"name", name}, {"ph", "M"}, {"pid", process}, {"tid", thread}, {"args", { {"name", value} }} });
+    }
+
+    void flushLocked(TraceState& state) {
+
+        if (!state.file.is_open()) return;
+
+        for (auto& buffer : state.buffers) {
+            if (!buffer->named) {
+                writeMetadata(state, "thread_name", hostProcess, buffer->thread, "Thread " + std::to_string(buffer->thread));
+                buffer->named = true;
+            }
+
+            // Chunks left by their writer (next is set) are freed once all of their events are written
+            while (true) {
+                auto count = buffer->head->count.load(std::memory_order_acquire);
+                for (; buffer->flushed < count; ++buffer->flushed) {
+                    const auto& event = buffer->head->events[buffer->flushed];
+                    if (event.beginNs < state.originNs) continue;
+
+                    bool onDevice = event.process == deviceProcess;
+                    writeEvent(state, {
+                            {"name", event.name},
+                            {"cat", onDevice ? "gpu" : "host"},
+                            {"ph", "X"},
+                            {"ts", static_cast<double>(event.beginNs - state.originNs) * 1e-3},
+                            {"dur", static_cast<double>(event.endNs - event.beginNs) * 1e-3},
+                            {"pid", event.process},
+                            {"tid", onDevice ? 0 : buffer->thread}
+                    });
+                }
+
+                auto next = buffer->head->next.load(std::memory_order_acquire);
+                if (!next || buffer->flushed < buffer->head->events.size()) break;
+                delete std::exchange(buffer->head, next);
+                buffer->flushed = 0;
+            }
+        }
+        state.file.flush();
+    }
+
+    void closeLocked(TraceState& state) {
+
+        flushLocked(state);
+        state.file << "\n]\n";
+        state.file.close();
+    }
+
+    // Trace ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    uint64_t Trace::start(const std::string& path) {
+
+        stop();
+
+        auto& state = traceState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.file.open(path, std::ios::trunc);
+        if (!state.file) throw std::runtime_error("failed to open trace file <" + path + ">!");
+
+        // The closing bracket is optional in the array format, so a trace cut short by a crash is still readable
+        state.file << "[\n";
+        state.firstEvent = true;
+        state.originNs = now();
+        for (auto& buffer : state.buffers) buffer->named = false;
+        writeMetadata(state, "process_name", hostProcess, 0, "HydroCore Host");
+        writeMetadata(state, "process_name", deviceProcess, 0, "HydroCore GPU");
+        writeMetadata(state, "thread_name", deviceProcess, 0, "Compute Queue");
+        s_enabled.store(true, std::memory_order_relaxed);
+        return ++state.session;
+    }
+
+    void Trace::stop() {
+
+        auto& state = traceState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.file.is_open()) return;
+
+        s_enabled.store(false, std::memory_order_relaxed);
+        closeLocked(state);
+    }
+
+    void Trace::stop(uint64_t session) {
+
+        auto& state = traceState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.file.is_open() || session != state.session) return;
+
+        s_enabled.store(false, std::memory_order_relaxed);
+        closeLocked(state);
+    }
+
+    void Trace::flush() {
+
+        auto& state = traceState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        flushLocked(state);
+    }
+
+    void Trace::host(const char* name, uint64_t beginNs, uint64_t endNs) {
+
+        append(hostProcess, name, beginNs, endNs);
+    }
+
+    void Trace::device(const std::string& name, uint64_t beginNs, uint64_t endNs) {
+
+        append(deviceProcess, name.c_str(), beginNs, endNs);
+    }
+}
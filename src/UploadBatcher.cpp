@@ -0,0 +1,133 @@
+//
+// Created by Yucheng Soku on 2024/11/25.
+//
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include "HydroCore/Trace.h"
+#include "HydroCore/UploadBatcher.h"
+
+namespace NextHydro {
+
+    // UploadBatcher ////////////////////////////////////////////////////////////////////////////////////////////////////
+
+    UploadBatcher::UploadBatcher(const VkDevice& device, Allocator& allocator, VkCommandPool commandPool, VkQueue queue, VkDeviceSize ringSize)
+            : m_device(device), m_allocator(allocator), m_commandPool(commandPool), m_queue(queue), m_ringSize(ringSize)
+    {}
+
+    UploadBatcher::~UploadBatcher() {
+
+        if (m_ring) m_ring->release();
+    }
+
+    bool UploadBatcher::writable(const Buffer* buffer) {
+
+        auto flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        return buffer->mappedData && (buffer->memoryFlags & flags) == flags;
+    }
+
+    void UploadBatcher::upload(Buffer* dstBuffer, const char* data, VkDeviceSize size, VkDeviceSize dstOffset) {
+
+        if (!size) return;
+
+        // Write directly, the memory is visible to the device at the next submission
+        if (writable(dstBuffer)) {
+            std::memcpy(static_cast<char*>(dstBuffer->mappedData) + dstOffset, data, static_cast<size_t>(size));
+            dstBuffer->flush(dstOffset, size);
+            return;
+        }
+
+        if (!m_ring) {
+            m_ring = std::make_unique<Buffer>(m_device, "Upload Staging Ring", m_allocator,
+                                              m_ringSize,
+                                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+            );
+        }
+
+        // Data larger than the free space of the ring is uploaded in pieces
+        VkDeviceSize uploaded = 0;
+        while (uploaded < size) {
+            if (m_ringHead >= m_ringSize) flush();
+
+            VkDeviceSize chunkSize = std::min(size - uploaded, m_ringSize - m_ringHead);
+            std::memcpy(static_cast<char*>(m_ring->mappedData) + m_ringHead, data + uploaded, static_cast<size_t>(chunkSize));
+
+            VkBufferCopy region {};
+            region.srcOffset = m_ringHead;
+            region.dstOffset = dstOffset + uploaded;
+            region.size = chunkSize;
+            m_pendingCommands.push_back({ dstBuffer->buffer, region, false, 0 });
+
+            // Keep copy sources 16-byte aligned
+            m_ringHead = (m_ringHead + chunkSize + 15) & ~VkDeviceSize(15);
+            uploaded += chunkSize;
+        }
+    }
+
+    void UploadBatcher::fill(Buffer* dstBuffer, uint32_t pattern, VkDeviceSize size, VkDeviceSize dstOffset) {
+
+        VkBufferCopy region {};
+        region.dstOffset = dstOffset;
+        region.size = size;
+        m_pendingCommands.push_back({ dstBuffer->buffer, region, true, pattern });
+    }
+
+    void UploadBatcher::flush() {
+
+        if (m_pendingCommands.empty()) return;
+        HYDRO_TRACE_SCOPE("flushUploads");
+
+        VkCommandBufferAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = m_commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        for (const auto& command : m_pendingCommands) {
+            if (command.fill) {
+                vkCmdFillBuffer(commandBuffer, command.dstBuffer, command.region.dstOffset, command.region.size, command.pattern);
+            } else {
+                vkCmdCopyBuffer(commandBuffer, m_ring->buffer, command.dstBuffer, 1, &command.region);
+            }
+        }
+
+        // Uploaded data is visible to every later command
+        VkMemoryBarrier barrier {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+        vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.commandBufferCount = 1;
+
+        if (vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit uploads!");
+        }
+        vkQueueWaitIdle(m_queue);
+        vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
+
+        m_pendingCommands.clear();
+        m_ringHead = 0;
+    }
+}
@@ -0,0 +1,73 @@
+#include <cmath>
+#include <random>
+#include <iomanip>
+#include <algorithm>
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// Minimum of one value per cell of the test grid by one global atomicMin per value (fixed-point as the old updateDt did,
+// and on float bits) against the built-in two-stage reduction, timed by the profiler
+int main() {
+
+    constexpr size_t valueCount = 802401;
+    constexpr uint32_t iterations = 20;
+
+    std::mt19937 random(20241202);
+    std::uniform_real_distribution<float> distribution(0.1f, 10.0f);
+    std::vector<float> values(valueCount);
+    for (auto& value : values) value = distribution(random);
+    float expected = *std::min_element(values.begin(), values.end());
+
+    // <bitsMin> starts at the bits of the huge value, which order like floats
+    NH::Flag huge {};
+    huge.f = 3.4e38f;
+
+    auto shader = (RESOURCE_PATH / fs::path("shaders/bench/atomicMin.comp")).string();
+    Json script = {
+            { "packing", "std430" },
+            { "storages", Json::array({
+                    { { "name", "values" }, { "resource", values }, { "layout", "F32" } },
+                    { { "name", "result" }, { "resource", { 4294967295u, huge.u, 3.4e38 } }, { "layout", { "U32", "U32", "F32" } } }
+            }) },
+            { "uniforms", Json::array() },
+            { "pipelines", Json::array({
+                    { { "name", "atomicMinFixed" }, { "path", shader }, { "defines", { { "FIXED_POINT", 1 } } } },
+                    { { "name", "atomicMinBits" }, { "path", shader } }
+            }) },
+            { "passes", Json::array({
+                    { { "name", "atomicFixedPass" }, { "shader", "atomicMinFixed" }, { "computeScale", { valueCount, 1, 1 } } },
+                    { { "name", "atomicBitsPass" }, { "shader", "atomicMinBits" }, { "computeScale", { valueCount, 1, 1 } } },
+                    { { "name", "reducePass" }, { "reduce", { { "operation", "min" }, { "source", "values" }, { "target", "result" }, { "targetIndex", 2 } } } }
+            }) },
+            { "flow", Json::array({
+                    { { "nodeName", "__BENCH__" }, { "passes", { "atomicFixedPass", "atomicBitsPass", "reducePass" } }, { "count", iterations }, { "type", 1 } }
+            }) }
+    };
+
+    auto core = HydroTest::createCore();
+    if (!core) return HydroTest::skipped;
+    core->setProfiling(true);
+    core->initialization(script);
+    while (core->step());
+
+    std::cout << std::left << std::setw(24) << "pass" << std::right << std::setw(10) << "count" << std::setw(12) << "mean(ms)"
+              << std::setw(12) << "p50(ms)" << std::setw(16) << "Gvalues/s" << std::endl;
+    for (const auto& statistics : core->profile()) {
+        std::cout << std::left << std::setw(24) << statistics.pass << std::right << std::setw(10) << statistics.count
+                  << std::fixed << std::setprecision(4) << std::setw(12) << statistics.meanMs << std::setw(12) << statistics.p50Ms
+                  << std::setw(16) << (statistics.meanMs > 0.0 ? double(valueCount) / (statistics.meanMs * 1e6) : 0.0) << std::endl;
+    }
+
+    // The fixed-point minimum loses everything below 1e-4, both other minima are exact
+    auto words = HydroTest::readStorage(*core, "result");
+    NH::Flag bits {}, reduced {};
+    bits.u = words[1];
+    reduced.u = words[2];
+    float fixed = float(words[0]) / 10000.0f;
+    std::cout << std::setprecision(9) << "Minimum: " << expected << ", fixed-point atomic: " << fixed
+              << ", float-bits atomic: " << bits.f << ", reduction: " << reduced.f << std::endl;
+
+    bool valid = std::fabs(fixed - expected) <= 1e-4f && bits.f == expected && reduced.f == expected;
+    return valid ? 0 : 1;
+}
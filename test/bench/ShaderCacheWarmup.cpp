@@ -0,0 +1,47 @@
+#include <chrono>
+#include <random>
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// Parse time of the script with an empty shader cache (every shader compiled from GLSL) against the parse time
+// with the cache filled by the first run (SPIR-V and pipeline cache read from disk)
+int main() {
+
+    auto directory = fs::temp_directory_path() / ("HydroCore-cache-bench-" + std::to_string(std::random_device{}()));
+    fs::remove_all(directory);
+    NH::Core::setShaderCacheDirectory(directory.string());
+
+    auto script = HydroTest::shrinkScript(HydroTest::loadScript(), 33, 65, 60.0f);
+    auto countEntries = [&directory]() {
+        std::error_code error;
+        return std::distance(fs::directory_iterator(directory, error), fs::directory_iterator());
+    };
+    auto parse = [&]() -> double {
+        auto core = HydroTest::createCore();
+        if (!core) return -1.0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        core->parseScript(script);
+        std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+        return duration.count();
+    };
+
+    auto cold = parse();
+    if (cold < 0.0) {
+        fs::remove_all(directory);
+        return HydroTest::skipped;
+    }
+    auto coldEntries = countEntries();
+    auto warm = parse();
+    auto warmEntries = countEntries();
+    fs::remove_all(directory);
+
+    std::cout << "Cold parse: " << cold << "ms (" << coldEntries << " cache entries written)" << std::endl;
+    std::cout << "Warm parse: " << warm << "ms (" << warmEntries - coldEntries << " cache entries written)" << std::endl;
+    std::cout << "Speedup: " << cold / warm << "x" << std::endl;
+
+    // A warm parse compiles nothing, so it writes no entry and has to be faster than compiling every shader
+    if (warmEntries != coldEntries) std::cout << "Warm parse missed the shader cache" << std::endl;
+    return warmEntries == coldEntries && warm < cold ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#include <iomanip>
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// GPU time of updateFlow and updateHeight reading global memory against their shared-memory tiled variants,
+// for grids from a few workgroups up to the grid of run.hcs.json
+int main() {
+
+    constexpr uint32_t steps = 50;
+    const std::vector<std::pair<uint32_t, uint32_t>> grids = { { 65, 129 }, { 201, 1001 }, { 401, 2001 } };
+    const std::vector<std::string> kernelPasses = { "flowPass", "heightPass" };
+
+    std::cout << std::left << std::setw(14) << "grid" << std::setw(14) << "pass" << std::right << std::setw(14) << "global(ms)"
+              << std::setw(14) << "tiled(ms)" << std::setw(12) << "speedup" << std::setw(16) << "Gcells/s" << std::endl;
+
+    for (const auto& [rowLength, rows] : grids) {
+
+        // Mean time of every pass over a fixed number of steps (the end time is never reached)
+        auto measure = [&, rowLength = rowLength, rows = rows](int tiledKernels) -> std::map<std::string, double> {
+            auto script = HydroTest::shrinkScript(HydroTest::loadScript(), rowLength, rows, 1e30f);
+            HydroTest::setDefine(script, "updateFlow", "TILED", tiledKernels);
+            HydroTest::setDefine(script, "updateHeight", "TILED", tiledKernels);
+
+            auto core = HydroTest::createCore();
+            if (!core) return {};
+            core->setProfiling(true);
+            core->initialization(script);
+            core->setPollInterval(1);
+            core->stepBatch(steps);
+
+            std::map<std::string, double> meanMs;
+            for (const auto& statistics : core->profile()) meanMs[statistics.pass] = statistics.meanMs;
+            return meanMs;
+        };
+
+        auto global = measure(0);
+        if (global.empty()) return HydroTest::skipped;
+        auto tiled = measure(1);
+
+        auto cells = double(rowLength) * rows;
+        for (const auto& pass : kernelPasses) {
+            std::cout << std::left << std::setw(14) << (std::to_string(rowLength) + " x " + std::to_string(rows)) << std::setw(14) << pass << std::right
+                      << std::fixed << std::setprecision(4) << std::setw(14) << global[pass] << std::setw(14) << tiled[pass]
+                      << std::setw(12) << (tiled[pass] > 0.0 ? global[pass] / tiled[pass] : 0.0)
+                      << std::setw(16) << (tiled[pass] > 0.0 ? cells / (tiled[pass] * 1e6) : 0.0) << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+#include <random>
+#include <algorithm>
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// Thousands of buffers are carved from small blocks and freed in random order: live allocations must never overlap
+// and must keep their alignment, freed ranges must merge back into one range per block, and the linear block of
+// transient allocations must be rewound once all of them are freed
+int main() {
+
+    auto core = HydroTest::createCore();
+    if (!core) return HydroTest::skipped;
+
+    constexpr VkDeviceSize blockSize = 1024 * 1024;
+    NH::Allocator allocator(core->device, core->physicalDevice, blockSize);
+    std::mt19937 random(20241202);
+    std::uniform_int_distribution<VkDeviceSize> words(64, 4096);
+
+    bool valid = true;
+    auto fail = [&valid](const std::string& message) {
+        std::cout << message << std::endl;
+        valid = false;
+    };
+
+    std::vector<std::unique_ptr<NH::Buffer>> buffers;
+    auto allocate = [&](size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            buffers.emplace_back(std::make_unique<NH::Buffer>(core->device, "Stress Buffer " + std::to_string(i), allocator,
+                                                              words(random) * sizeof(uint32_t),
+                                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+            ));
+        }
+    };
+    auto release = [&](size_t count) {
+        std::shuffle(buffers.begin(), buffers.end(), random);
+        for (size_t i = 0; i < count && !buffers.empty(); ++i) {
+            buffers.back()->release();
+            buffers.pop_back();
+        }
+    };
+    auto checkLive = [&](const std::string& phase) {
+        std::vector<const NH::Allocation*> allocations;
+        for (const auto& buffer : buffers) {
+            const auto& allocation = buffer->allocation;
+            if (allocation.offset % buffer->getMemoryRequirements().alignment || allocation.offset % allocator.limits().minStorageBufferOffsetAlignment) {
+                fail(phase + ": allocation at offset " + std::to_string(allocation.offset) + " is not aligned");
+            }
+            allocations.push_back(&allocation);
+        }
+        std::sort(allocations.begin(), allocations.end(), [](const NH::Allocation* a, const NH::Allocation* b) {
+            return a->memory != b->memory ? a->memory < b->memory : a->offset < b->offset;
+        });
+        for (size_t i = 1; i < allocations.size(); ++i) {
+            const auto& previous = *allocations[i - 1];
+            const auto& current = *allocations[i];
+            if (previous.memory == current.memory && previous.offset + previous.size > current.offset) {
+                fail(phase + ": allocations at offsets " + std::to_string(previous.offset) + " and " + std::to_string(current.offset) + " overlap");
+            }
+        }
+    };
+
+    // Allocate, free a random half and refill the holes
+    allocate(4000);
+    checkLive("initial allocations");
+    uint32_t memoryType = buffers.front()->allocation.memoryType;
+    auto initial = allocator.statistics(memoryType);
+    release(2000);
+    allocate(2000);
+    checkLive("reallocations");
+    auto refilled = allocator.statistics(memoryType);
+    std::cout << "Blocks after allocating: " << initial.blockCount << ", after refilling freed ranges: " << refilled.blockCount << std::endl;
+
+    // Every block holds a single free range spanning the whole block once everything is freed
+    release(buffers.size());
+    auto freed = allocator.statistics(memoryType);
+    if (freed.allocationCount || freed.usedSize) fail("freed blocks still hold " + std::to_string(freed.allocationCount) + " allocations");
+    if (freed.freeRangeCount != freed.blockCount) fail(std::to_string(freed.freeRangeCount) + " free ranges are left in " + std::to_string(freed.blockCount) + " blocks");
+    if (freed.largestFreeRange != blockSize) fail("largest free range of " + std::to_string(freed.largestFreeRange) + " bytes is not a whole block");
+
+    // A block-sized buffer fits into a merged block without a new device allocation
+    auto deviceAllocations = allocator.deviceAllocationCount();
+    NH::Buffer whole(core->device, "Whole Block Buffer", allocator, blockSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (allocator.deviceAllocationCount() != deviceAllocations) fail("block-sized buffer needed a new device allocation");
+    whole.release();
+
+    // Transient allocations are bumped linearly and rewound once all of them are freed
+    std::vector<std::unique_ptr<NH::Buffer>> transients;
+    for (size_t round = 0; round < 2; ++round) {
+        VkDeviceSize head = 0;
+        for (size_t i = 0; i < 50; ++i) {
+            transients.emplace_back(std::make_unique<NH::Buffer>(core->device, "Transient Buffer " + std::to_string(i), allocator,
+                                                                 words(random) * sizeof(uint32_t),
+                                                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                                 0,
+                                                                 true
+            ));
+            const auto& allocation = transients.back()->allocation;
+            if (!allocation.transient) continue;
+            if (i == 0 && allocation.offset != 0) fail("round " + std::to_string(round) + ": transient block is not rewound");
+            if (allocation.offset < head) fail("transient allocation at offset " + std::to_string(allocation.offset) + " is not bumped linearly");
+            head = allocation.offset + allocation.size;
+        }
+        for (auto& transient : transients) {
+            transient->release();
+        }
+        transients.clear();
+    }
+
+    std::cout << (valid ? "Allocator is consistent" : "Allocator is inconsistent") << std::endl;
+    return valid ? 0 : 1;
+}
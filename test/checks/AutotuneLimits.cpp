@@ -0,0 +1,54 @@
+#include <random>
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// Autotuned pipelines stay inside the workgroup and shared memory limits of the device and compute the same results
+// as the pipelines configured by the script (tiles and the fused timestep minimum do not depend on the workgroup size)
+int main() {
+
+    auto script = HydroTest::shrinkScript(HydroTest::loadScript(), 33, 65, 60.0f);
+
+    auto baselineCore = HydroTest::createCore();
+    if (!baselineCore) return HydroTest::skipped;
+    baselineCore->initialization(script);
+
+    // Shared memory of the tiled updateFlow is reflected from its SPIR-V for every workgroup size (16 * (x + 2) * (y + 2) + 4 bytes)
+    bool valid = true;
+    const auto& flowPipeline = baselineCore->name_pipeline_map.at("updateFlow");
+    auto expectShared = [&](const NH::SpecializationConstants& specialization, uint64_t expected) {
+        auto reflected = NH::reflectSharedMemorySize(flowPipeline->computeShaderModule->spirvCode, specialization);
+        if (reflected == expected) return;
+        std::cout << "updateFlow declares " << reflected << " bytes of shared memory instead of " << expected << std::endl;
+        valid = false;
+    };
+    expectShared(flowPipeline->specialization, 16 * (flowPipeline->localSize[0] + 2) * (flowPipeline->localSize[1] + 2) + 4);
+    expectShared({ { 0, 1 }, { 1, 1024 } }, 16 * 3 * 1026 + 4);
+
+    while (baselineCore->step());
+    auto baseline = HydroTest::snapshot(*baselineCore);
+    baselineCore.reset();
+
+    auto database = fs::temp_directory_path() / ("HydroCore-tuning-" + std::to_string(std::random_device{}()) + ".json");
+    auto core = HydroTest::createCore();
+    core->setTuningDatabase(database.string());
+    core->setAutotune(true, 2);
+    core->initialization(script);
+
+    const auto& limits = core->allocator->limits();
+    for (const auto& [name, pipeline] : core->name_pipeline_map) {
+        const auto& size = pipeline->localSize;
+        std::cout << "Pipeline <" << name << ">: " << size[0] << " x " << size[1] << " x " << size[2] << ", " << pipeline->sharedMemorySize << " bytes of shared memory" << std::endl;
+        if (size[0] > limits.maxComputeWorkGroupSize[0] || size[1] > limits.maxComputeWorkGroupSize[1] || size[2] > limits.maxComputeWorkGroupSize[2] ||
+            uint64_t(size[0]) * size[1] * size[2] > limits.maxComputeWorkGroupInvocations || pipeline->sharedMemorySize > limits.maxComputeSharedMemorySize) {
+            std::cout << "Pipeline <" << name << "> exceeds the limits of the device" << std::endl;
+            valid = false;
+        }
+    }
+
+    while (core->step());
+    valid &= HydroTest::identical(baseline, HydroTest::snapshot(*core), "autotuned pipelines");
+    core.reset();
+    fs::remove(database);
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include <random>
+#include "HydroTest.h"
+#include "HydroCore/Cluster.h"
+
+namespace NH = NextHydro;
+
+// Strips of a cluster (several logical devices on the same physical device) must end in the grid of a single core:
+// every strip owns its rows, the ghost rows are refreshed by the halo exchange and the timestep is the minimum over all strips
+int main() {
+
+    auto script = HydroTest::shrinkScript(HydroTest::loadScript(), 33, 65, 60.0f);
+    auto rowLength = script["decomposition"]["rowLength"].get<uint32_t>();
+    const std::vector<std::string> rowStorages = { "hn", "qn_x", "qn_y" };
+
+    auto core = HydroTest::createCore();
+    if (!core) return HydroTest::skipped;
+    core->initialization(script);
+    core->setPollInterval(1);
+    while (core->step());
+    auto baseline = HydroTest::snapshot(*core, { "scalars", "hn", "qn_x", "qn_y" });
+    core.reset();
+
+    // Clusters read their script from a file
+    auto path = fs::temp_directory_path() / ("HydroCore-cluster-" + std::to_string(std::random_device{}()) + ".hcs.json");
+    {
+        std::ofstream file(path);
+        file << script.dump(4);
+    }
+
+    bool valid = true;
+    for (size_t stripCount : { 2, 3 }) {
+        NH::Cluster cluster(std::vector<int32_t>(stripCount, -1));
+        cluster.initialization(path.string());
+        size_t steps = 0;
+        while (cluster.step()) ++steps;
+        std::cout << stripCount << " strips: " << steps << " steps" << std::endl;
+
+        for (size_t i = 0; i < cluster.strips.size(); ++i) {
+            auto& strip = cluster.strips[i];
+            auto label = std::to_string(stripCount) + " strips, strip " + std::to_string(i) + " (rows " + std::to_string(strip.ownedBegin) + " to " + std::to_string(strip.ownedEnd) + ")";
+
+            // Owned rows of the strip against the same rows of the single core
+            HydroTest::Snapshot expected, actual;
+            for (const auto& name : rowStorages) {
+                auto words = HydroTest::readStorage(*strip.core, name);
+                auto begin = size_t(strip.ownedBegin - strip.rowOffset) * rowLength;
+                auto end = size_t(strip.ownedEnd - strip.rowOffset) * rowLength;
+                actual[name].assign(words.begin() + begin, words.begin() + end);
+
+                const auto& baselineWords = baseline.at(name);
+                expected[name].assign(baselineWords.begin() + size_t(strip.ownedBegin) * rowLength, baselineWords.begin() + size_t(strip.ownedEnd) * rowLength);
+            }
+            expected["scalars"] = baseline.at("scalars");
+            actual["scalars"] = HydroTest::readStorage(*strip.core, "scalars");
+            valid &= HydroTest::identical(expected, actual, label);
+        }
+    }
+
+    fs::remove(path);
+    return valid ? 0 : 1;
+}
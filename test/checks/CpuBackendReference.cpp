@@ -0,0 +1,52 @@
+#include "HydroTest.h"
+#include "HydroCore/CpuKernels.h"
+
+namespace NH = NextHydro;
+
+// The CPU backend is the reference of the shallow-water kernels: one scalar thread, every instruction set the CPU supports
+// and every thread count must end in bit-identical grids. The GPU evaluates divisions, square roots and powers with the
+// precision Vulkan allows (not correctly rounded), so it is compared after a fixed number of steps within a tolerance.
+int main() {
+
+    constexpr uint32_t deviceSteps = 20;
+    constexpr float deviceTolerance = 1e-3f;
+    auto script = HydroTest::shrinkScript(HydroTest::loadScript(), 33, 65, 60.0f);
+
+    auto runHost = [&](NH::CpuBackend& backend, uint32_t steps) {
+        backend.initialization(script);
+        for (uint32_t i = 0; (steps == 0 || i < steps) && backend.stepBatch(1); ++i);
+        return HydroTest::hostSnapshot(backend);
+    };
+
+    NH::CpuKernels::useInstructionSet("scalar");
+    NH::CpuBackend referenceBackend(1);
+    auto reference = runHost(referenceBackend, 0);
+
+    bool valid = true;
+    for (const auto& instructionSet : NH::CpuKernels::instructionSets()) {
+        NH::CpuKernels::useInstructionSet(instructionSet);
+
+        NH::Core core(NH::Core::hostDevice);
+        auto backend = core.cpuBackend.get();
+        valid &= HydroTest::identical(reference, runHost(*backend, 0), instructionSet + " on " + std::to_string(backend->pool.size() + 1) + " threads");
+
+        // Batches stop at the same iteration as single steps
+        NH::CpuBackend batchedBackend(3);
+        batchedBackend.initialization(script);
+        while (batchedBackend.stepBatch(8));
+        valid &= HydroTest::identical(reference, HydroTest::hostSnapshot(batchedBackend), instructionSet + " in batches of 8");
+    }
+    NH::CpuKernels::useInstructionSet(NH::CpuKernels::instructionSets().front());
+
+    // The device is optional here, the host comparisons above are the point of this check
+    auto deviceCore = HydroTest::createCore();
+    if (!deviceCore) return valid ? 0 : 1;
+
+    deviceCore->initialization(script);
+    deviceCore->setPollInterval(1);
+    for (uint32_t i = 0; i < deviceSteps; ++i) deviceCore->step();
+
+    NH::CpuBackend hostBackend;
+    valid &= HydroTest::close(runHost(hostBackend, deviceSteps), HydroTest::snapshot(*deviceCore), "GPU after " + std::to_string(deviceSteps) + " steps", deviceTolerance);
+    return valid ? 0 : 1;
+}
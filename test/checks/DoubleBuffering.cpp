@@ -0,0 +1,81 @@
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// A double-buffered storage over odd and even iteration counts, stepped one iteration and three iterations at a time:
+// every iteration swaps the buffers behind <state> and <state_prev>, and <state_prev> ends with the values a run
+// copying <state> back to <state_prev> after every iteration ends with
+int main() {
+
+    constexpr uint32_t valueCount = 1000;
+
+    std::vector<float> initial(valueCount);
+    for (uint32_t i = 0; i < valueCount; ++i) initial[i] = 0.25f * float(i % 17);
+
+    auto shader = (RESOURCE_PATH / fs::path("shaders/checks/smooth.comp")).string();
+    auto makeScript = [&](bool doubleBuffered, uint32_t count) -> Json {
+        Json script = {
+                { "packing", "std430" },
+                { "storages", Json::array() },
+                { "uniforms", Json::array() },
+                { "pipelines", Json::array({
+                        { { "name", "smooth" }, { "path", shader }, { "defines", { { "COUNT", valueCount } } } }
+                }) },
+                { "passes", Json::array({
+                        { { "name", "smoothPass" }, { "shader", "smooth" }, { "computeScale", { valueCount, 1, 1 } } }
+                }) }
+        };
+        script["storages"].push_back({ { "name", "state" }, { "resource", initial }, { "layout", "F32" }, { "doubleBuffered", doubleBuffered } });
+        std::vector<std::string> passes = { "smoothPass" };
+
+        // <state_prev> is the default name of the second buffer of a pair, without one it is a storage of its own
+        if (!doubleBuffered) {
+            script["storages"].push_back({ { "name", "state_prev" }, { "resource", initial }, { "layout", "F32" } });
+            script["pipelines"].push_back({ { "name", "copy" }, { "path", shader }, { "defines", { { "COUNT", valueCount }, { "COPY", 1 } } } });
+            script["passes"].push_back({ { "name", "copyPass" }, { "shader", "copy" }, { "computeScale", { valueCount, 1, 1 } } });
+            passes.emplace_back("copyPass");
+        }
+        script["flow"] = Json::array({ { { "nodeName", "smoothNode" }, { "passes", passes }, { "count", count }, { "type", 1 } } });
+        return script;
+    };
+
+    bool valid = true;
+
+    // An iterable node of count C runs C + 2 iterations (see IterableCommandNode::clampIterations)
+    for (uint32_t count : { 3u, 4u }) {
+        uint32_t iterations = count + 2;
+
+        auto copying = HydroTest::createCore();
+        if (!copying) return HydroTest::skipped;
+        copying->initialization(makeScript(false, count));
+        while (copying->step());
+        auto expected = HydroTest::snapshot(*copying, { "state_prev" });
+        copying.reset();
+
+        for (uint32_t batch : { 1u, 3u }) {
+            auto label = "double-buffered, " + std::to_string(iterations) + " iterations in batches of " + std::to_string(batch);
+
+            auto core = HydroTest::createCore();
+            core->initialization(makeScript(true, count));
+            auto stateBuffer = core->currentBuffer("state");
+            auto previousBuffer = core->currentBuffer("state_prev");
+            if (!stateBuffer || !previousBuffer || stateBuffer == previousBuffer) {
+                std::cout << label << ": <state> and <state_prev> are not a pair of buffers" << std::endl;
+                valid = false;
+                continue;
+            }
+
+            while (core->stepBatch(batch));
+
+            // An odd number of swaps leaves the names on the other buffer
+            bool odd = iterations % 2 == 1;
+            if (core->currentBuffer("state") != (odd ? previousBuffer : stateBuffer) || core->currentBuffer("state_prev") != (odd ? stateBuffer : previousBuffer)) {
+                std::cout << label << ": buffers behind <state> and <state_prev> are " << (odd ? "not swapped" : "swapped") << std::endl;
+                valid = false;
+            }
+            valid &= HydroTest::identical(expected, HydroTest::snapshot(*core, { "state_prev" }), label);
+        }
+    }
+
+    return valid ? 0 : 1;
+}
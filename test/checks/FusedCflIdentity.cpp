@@ -0,0 +1,35 @@
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// The timestep reduced from the per-workgroup minima of the fused updateFlow must be the same float as the one reduced
+// from the per-cell timesteps of the unfused kernel, so both runs take the same steps and end in identical grids
+int main() {
+
+    auto fused = HydroTest::shrinkScript(HydroTest::loadScript(), 33, 65, 60.0f);
+
+    // Unfused: every cell writes its timestep to <dt3>, the reduction skips the zeros of cells without one
+    auto unfused = fused;
+    HydroTest::setDefine(unfused, "updateFlow", "FUSED_CFL", 0);
+    auto cells = fused["decomposition"]["rowLength"].get<uint64_t>() * fused["decomposition"]["rows"].get<uint64_t>();
+    unfused["storages"].push_back({ { "name", "dt3" }, { "resource", { { "length", cells } } }, { "layout", "F32" } });
+    for (auto& passInfo : unfused["passes"]) {
+        if (passInfo["name"] != "updateDtPass") continue;
+        passInfo["reduce"]["source"] = "dt3";
+        passInfo["reduce"]["ignore"] = 0.0;
+    }
+
+    auto run = [](const Json& script) -> std::optional<HydroTest::Snapshot> {
+        auto core = HydroTest::createCore();
+        if (!core) return std::nullopt;
+
+        core->initialization(script);
+        core->setPollInterval(1);
+        while (core->step());
+        return HydroTest::snapshot(*core);
+    };
+
+    auto baseline = run(unfused);
+    if (!baseline) return HydroTest::skipped;
+    return HydroTest::identical(*baseline, *run(fused), "fused CFL") ? 0 : 1;
+}
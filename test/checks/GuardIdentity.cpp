@@ -0,0 +1,35 @@
+#include <functional>
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// Results of the indirect-dispatch guard must be identical to the baseline of serialized, unguarded steps:
+// every execution mode only changes how steps are submitted and checked, never what a step computes
+int main() {
+
+    auto script = HydroTest::shrinkScript(HydroTest::loadScript(), 33, 65, 60.0f);
+
+    // <configure> runs after initialization, <batch> iterations are submitted per step
+    auto run = [&](const std::function<void(NH::Core&)>& configure, uint32_t batch) -> std::optional<HydroTest::Snapshot> {
+        auto core = HydroTest::createCore();
+        if (!core) return std::nullopt;
+
+        core->initialization(script);
+        configure(*core);
+        while (core->stepBatch(batch));
+        return HydroTest::snapshot(*core);
+    };
+
+    // Baseline: full barriers between passes, every step checked on the host before the next one
+    auto baseline = run([](NH::Core& core) { core.setSerializedExecution(true); core.setPollInterval(1); }, 1);
+    if (!baseline) return HydroTest::skipped;
+
+    bool same = true;
+    same &= HydroTest::identical(*baseline, *run([](NH::Core& core) { core.setPollInterval(1); }, 1), "inferred barriers");
+    same &= HydroTest::identical(*baseline, *run([](NH::Core& core) { core.setPollInterval(1); }, 8), "guarded batches");
+    same &= HydroTest::identical(*baseline, *run([](NH::Core& core) { core.setPollInterval(16); }, 1), "blind guard");
+    same &= HydroTest::identical(*baseline, *run([](NH::Core& core) { core.setPollInterval(16); }, 8), "blind guarded batches");
+    same &= HydroTest::identical(*baseline, *run([](NH::Core& core) { core.setPollInterval(1); core.setFramesInFlight(2); }, 1), "frames in flight");
+    same &= HydroTest::identical(*baseline, *run([](NH::Core& core) { core.setPollInterval(1); core.setFramesInFlight(2); }, 4), "batched frames in flight");
+    return same ? 0 : 1;
+}
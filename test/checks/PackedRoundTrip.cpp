@@ -0,0 +1,171 @@
+#include <cmath>
+#include <limits>
+#include "HydroTest.h"
+#include "HydroCore/Block.h"
+
+namespace NH = NextHydro;
+
+namespace {
+
+    struct Half {
+        float       value;
+        uint32_t    bits;
+        float       unpacked;
+    };
+
+    constexpr float infinity = std::numeric_limits<float>::infinity();
+
+    // Halves on both sides of the normal range, ties rounded to even, signed zeros, infinities and a NaN
+    const std::vector<Half> halves = {
+            { 1.0f,                        0x3c00, 1.0f },
+            { -2.0f,                       0xc000, -2.0f },
+            { 0.333333f,                   0x3555, 0.333251953125f },
+            { 65504.0f,                    0x7bff, 65504.0f },
+            { 65520.0f,                    0x7c00, infinity },                      // halfway to the next half, rounds to infinity
+            { infinity,                    0x7c00, infinity },
+            { -infinity,                   0xfc00, -infinity },
+            { std::ldexp(1.0f, -14),       0x0400, std::ldexp(1.0f, -14) },         // smallest normal
+            { std::ldexp(1.0f, -24),       0x0001, std::ldexp(1.0f, -24) },         // smallest subnormal
+            { std::ldexp(1.0f, -25),       0x0000, 0.0f },                          // halfway to zero, rounds to even
+            { std::ldexp(3.0f, -26),       0x0001, std::ldexp(1.0f, -24) },
+            { std::ldexp(3.0f, -24),       0x0003, std::ldexp(3.0f, -24) },
+            { std::ldexp(-1023.0f, -24),   0x83ff, std::ldexp(-1023.0f, -24) },     // largest subnormal
+            { -0.0f,                       0x8000, -0.0f },
+            { std::numeric_limits<float>::quiet_NaN(), 0x7e00, std::numeric_limits<float>::quiet_NaN() }
+    };
+
+    // U8 clamps to [0, 255]
+    const std::vector<int> byteInputs = { 0, 1, 127, 128, 254, 255, 300, -5, 42 };
+    const std::vector<uint32_t> bytes = { 0, 1, 127, 128, 254, 255, 255, 0, 42 };
+    const std::vector<uint32_t> byteWords = { 0x807f0100, 0x00fffffe, 0x0000002a };
+
+    // Element i of a mask is bit i % 32 of word i / 32
+    constexpr uint32_t maskCount = 70;
+    bool maskBit(uint32_t i) { return i % 3 == 0 || i == 31 || i == 32; }
+    const std::vector<uint32_t> maskWords = { 0xc9249249, 0x92492493, 0x00000024 };
+
+    std::vector<uint32_t> blockWords(const NH::Block& block) {
+
+        auto words = reinterpret_cast<const uint32_t*>(block.buffer.get());
+        return { words, words + block.size / sizeof(uint32_t) };
+    }
+
+    bool sameWords(const std::string& label, const std::vector<uint32_t>& expected, const std::vector<uint32_t>& actual) {
+
+        bool same = actual.size() >= expected.size();
+        for (size_t i = 0; same && i < expected.size(); ++i) {
+            if (actual[i] == expected[i]) continue;
+            std::cout << label << ": word " << i << " is 0x" << std::hex << actual[i] << " instead of 0x" << expected[i] << std::dec << std::endl;
+            same = false;
+        }
+        if (actual.size() < expected.size()) std::cout << label << ": " << actual.size() << " words instead of " << expected.size() << std::endl;
+        return same;
+    }
+
+    bool sameFloat(float expected, float actual) {
+
+        if (std::isnan(expected)) return std::isnan(actual);
+        return actual == expected && std::signbit(actual) == std::signbit(expected);
+    }
+}
+
+// Known values through the packed layouts: the words Block encodes on the host, and the elements the unpack helpers
+// of "hydrocore/packing.glsl" read back from these words on the device
+int main() {
+
+    bool valid = true;
+
+    // Host encoding
+    Json halfInputs = Json::array();
+    std::vector<uint32_t> halfWords((halves.size() + 1) / 2, 0);
+    for (size_t i = 0; i < halves.size(); ++i) {
+        halfInputs.push_back(halves[i].value);
+        halfWords[i / 2] |= halves[i].bits << ((i % 2) * 16);
+    }
+    Json maskInputs = Json::array();
+    for (uint32_t i = 0; i < maskCount; ++i) maskInputs.push_back(maskBit(i));
+
+    NH::Block halfBlock(Json("F16"), halfInputs);
+    NH::Block byteBlock(Json("U8"), Json(byteInputs));
+    NH::Block maskBlock(Json("Mask"), maskInputs);
+    valid &= sameWords("F16 block", halfWords, blockWords(halfBlock)) && halfBlock.stride == 4;
+    valid &= sameWords("U8 block", byteWords, blockWords(byteBlock)) && byteBlock.stride == 4;
+    valid &= sameWords("Mask block", maskWords, blockWords(maskBlock)) && maskBlock.stride == 4;
+
+    // A fill value is repeated for every element of a word
+    NH::Block halfFill(Json("F16"), Json({ { "length", 5 }, { "fill", 1.0 } }));
+    NH::Block byteFill(Json("U8"), Json({ { "length", 5 }, { "fill", 7 } }));
+    NH::Block maskFill(Json("Mask"), Json({ { "length", 5 }, { "fill", 1 } }));
+    valid &= sameWords("F16 fill", { 0x3c003c00 }, { halfFill.fillPattern }) && halfFill.size == 12;
+    valid &= sameWords("U8 fill", { 0x07070707 }, { byteFill.fillPattern }) && byteFill.size == 8;
+    valid &= sameWords("Mask fill", { 0xffffffff }, { maskFill.fillPattern }) && maskFill.size == 4;
+    std::cout << "Host encoding: " << (valid ? "valid" : "invalid") << std::endl;
+
+    // Device decoding
+    auto shader = (RESOURCE_PATH / fs::path("shaders/checks/unpack.comp")).string();
+    Json script = {
+            { "packing", "std430" },
+            { "storages", Json::array({
+                    { { "name", "halves" }, { "resource", halfInputs }, { "layout", "F16" } },
+                    { { "name", "bytes" }, { "resource", byteInputs }, { "layout", "U8" } },
+                    { { "name", "masks" }, { "resource", maskInputs }, { "layout", "Mask" } },
+                    { { "name", "halfValues" }, { "resource", { { "length", halves.size() } } }, { "layout", "F32" } },
+                    { { "name", "byteValues" }, { "resource", { { "length", bytes.size() } } }, { "layout", "U32" } },
+                    { { "name", "maskValues" }, { "resource", { { "length", maskCount } } }, { "layout", "U32" } }
+            }) },
+            { "uniforms", Json::array() },
+            { "pipelines", Json::array({
+                    { { "name", "unpack" }, { "path", shader }, { "defines", {
+                            { "HALF_COUNT", halves.size() }, { "BYTE_COUNT", bytes.size() }, { "MASK_COUNT", maskCount }
+                    } } }
+            }) },
+            { "passes", Json::array({
+                    { { "name", "unpackPass" }, { "shader", "unpack" }, { "computeScale", { maskCount, 1, 1 } } }
+            }) },
+            { "flow", Json::array({
+                    { { "nodeName", "unpackNode" }, { "passes", { "unpackPass" } }, { "count", 1 }, { "type", 1 } }
+            }) }
+    };
+
+    auto core = HydroTest::createCore();
+    if (!core) return valid ? HydroTest::skipped : 1;
+    core->initialization(script);
+    while (core->step());
+
+    valid &= sameWords("F16 storage", halfWords, HydroTest::readStorage(*core, "halves"));
+    valid &= sameWords("U8 storage", byteWords, HydroTest::readStorage(*core, "bytes"));
+    valid &= sameWords("Mask storage", maskWords, HydroTest::readStorage(*core, "masks"));
+
+    // Devices may flush subnormal halves to zero (of the same sign), which is reported but accepted
+    auto halfValues = HydroTest::readStorage(*core, "halfValues");
+    for (size_t i = 0; i < halves.size(); ++i) {
+        NH::Flag actual {};
+        actual.u = halfValues[i];
+        if (sameFloat(halves[i].unpacked, actual.f)) continue;
+
+        bool subnormal = (halves[i].bits & 0x7c00u) == 0 && (halves[i].bits & 0x3ffu) != 0;
+        if (subnormal && sameFloat(std::copysign(0.0f, halves[i].unpacked), actual.f)) {
+            std::cout << "unpackF16: subnormal half 0x" << std::hex << halves[i].bits << std::dec << " is flushed to zero" << std::endl;
+            continue;
+        }
+        std::cout << "unpackF16: element " << i << " is " << actual.f << " instead of " << halves[i].unpacked << std::endl;
+        valid = false;
+    }
+
+    auto byteValues = HydroTest::readStorage(*core, "byteValues");
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        if (byteValues[i] == bytes[i]) continue;
+        std::cout << "unpackU8: element " << i << " is " << byteValues[i] << " instead of " << bytes[i] << std::endl;
+        valid = false;
+    }
+
+    auto maskValues = HydroTest::readStorage(*core, "maskValues");
+    for (uint32_t i = 0; i < maskCount; ++i) {
+        if (maskValues[i] == uint32_t(maskBit(i))) continue;
+        std::cout << "unpackMask: element " << i << " is " << maskValues[i] << " instead of " << maskBit(i) << std::endl;
+        valid = false;
+    }
+
+    std::cout << "Packed round trip: " << (valid ? "valid" : "invalid") << std::endl;
+    return valid ? 0 : 1;
+}
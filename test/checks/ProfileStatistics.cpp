@@ -0,0 +1,76 @@
+#include <iomanip>
+#include <algorithm>
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// Statistics of the profiler after a batched step and single steps of an iterable node: one entry per pass, counting
+// every executed iteration, with non-negative and ordered percentiles
+int main() {
+
+    constexpr size_t valueCount = 4096;
+    constexpr uint32_t iterations = 12;
+    constexpr uint32_t batch = 5;
+
+    std::vector<float> values(valueCount);
+    for (size_t i = 0; i < valueCount; ++i) values[i] = 1.0f + float(i % 97);
+
+    auto shader = (RESOURCE_PATH / fs::path("shaders/bench/atomicMin.comp")).string();
+    const std::vector<std::string> passes = { "atomicFixedPass", "atomicBitsPass" };
+    Json script = {
+            { "packing", "std430" },
+            { "storages", Json::array({
+                    { { "name", "values" }, { "resource", values }, { "layout", "F32" } },
+                    { { "name", "result" }, { "resource", { 4294967295u, 4294967295u, 0.0 } }, { "layout", { "U32", "U32", "F32" } } }
+            }) },
+            { "uniforms", Json::array() },
+            { "pipelines", Json::array({
+                    { { "name", "atomicMinFixed" }, { "path", shader }, { "defines", { { "FIXED_POINT", 1 } } } },
+                    { { "name", "atomicMinBits" }, { "path", shader } }
+            }) },
+            { "passes", Json::array({
+                    { { "name", passes[0] }, { "shader", "atomicMinFixed" }, { "computeScale", { valueCount, 1, 1 } } },
+                    { { "name", passes[1] }, { "shader", "atomicMinBits" }, { "computeScale", { valueCount, 1, 1 } } }
+            }) },
+            { "flow", Json::array({
+                    { { "nodeName", "profileNode" }, { "passes", passes }, { "count", iterations }, { "type", 1 } }
+            }) }
+    };
+
+    auto core = HydroTest::createCore();
+    if (!core) return HydroTest::skipped;
+
+    // Nothing is profiled until profiling is enabled
+    bool valid = core->profile().empty();
+    core->setProfiling(true);
+    core->initialization(script);
+
+    // One recording of <batch> iterations, then recordings of a single one until the node is complete
+    // (the host counts the iterations, an iterable node runs once more after every check of it)
+    uint32_t executed = batch;
+    bool running = core->stepBatch(batch);
+    while (running) {
+        running = core->step();
+        ++executed;
+    }
+    std::cout << "Executed iterations: " << executed << std::endl;
+
+    auto statistics = core->profile();
+    valid &= statistics.size() == passes.size();
+    for (const auto& pass : passes) {
+        auto it = std::find_if(statistics.begin(), statistics.end(), [&pass](const NH::PassStatistics& entry) { return entry.pass == pass; });
+        if (it == statistics.end()) {
+            std::cout << "Pass <" << pass << "> has no statistics" << std::endl;
+            valid = false;
+            continue;
+        }
+
+        std::cout << std::left << std::setw(20) << it->pass << std::right << " count " << it->count << std::fixed << std::setprecision(4)
+                  << ", mean " << it->meanMs << " ms, p50 " << it->p50Ms << " ms, p99 " << it->p99Ms << " ms, total " << it->totalMs << " ms" << std::endl;
+        valid &= it->count == executed;
+        valid &= it->meanMs >= 0.0 && it->p50Ms >= 0.0 && it->p50Ms <= it->p99Ms && it->p99Ms <= it->totalMs;
+    }
+
+    std::cout << "Profile statistics: " << (valid ? "valid" : "invalid") << std::endl;
+    return valid ? 0 : 1;
+}
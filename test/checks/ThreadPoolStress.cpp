@@ -0,0 +1,66 @@
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include "HydroCore/ThreadPool.h"
+
+namespace NH = NextHydro;
+
+// Loops and submitted tasks share the workers of the pool: every chunk runs exactly once, results of tasks arrive through
+// their futures, an exception of a chunk reaches the caller once all other chunks are done, and the pool stays usable
+int main() {
+
+    NH::ThreadPool pool(4);
+    bool valid = true;
+    auto fail = [&valid](const std::string& message) {
+        std::cout << message << std::endl;
+        valid = false;
+    };
+
+    for (size_t round = 0; round < 2000 && valid; ++round) {
+        std::vector<uint32_t> counts(1000, 0);
+        pool.parallelFor(0, counts.size(), 1 + round % 13, [&counts](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) ++counts[i];
+        });
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (counts[i] != 1) {
+                fail("round " + std::to_string(round) + ": element " + std::to_string(i) + " was visited " + std::to_string(counts[i]) + " times");
+                break;
+            }
+        }
+
+        auto result = pool.submit([round] { return round * 2; });
+        if (result.get() != round * 2) fail("round " + std::to_string(round) + ": submitted task returned a wrong result");
+    }
+
+    // Loops started by several threads at once
+    std::atomic<size_t> visited { 0 };
+    std::vector<std::future<void>> loops;
+    for (size_t i = 0; i < 4; ++i) {
+        loops.emplace_back(std::async(std::launch::async, [&pool, &visited] {
+            for (size_t round = 0; round < 200; ++round) {
+                pool.parallelFor(0, 100, 3, [&visited](size_t begin, size_t end) { visited += end - begin; });
+            }
+        }));
+    }
+    for (auto& loop : loops) loop.get();
+    if (visited != 4 * 200 * 100) fail("concurrent loops visited " + std::to_string(visited.load()) + " elements instead of 80000");
+
+    // The exception of one chunk is rethrown, after every other chunk finished
+    std::atomic<size_t> finished { 0 };
+    try {
+        pool.parallelFor(0, 100, 1, [&finished](size_t begin, size_t) {
+            if (begin == 50) throw std::runtime_error("chunk 50 failed");
+            ++finished;
+        });
+        fail("exception of a chunk was not rethrown");
+    } catch (const std::runtime_error& error) {
+        if (std::string(error.what()) != "chunk 50 failed") fail("wrong exception was rethrown");
+    }
+    if (finished != 99) fail(std::to_string(finished.load()) + " chunks finished instead of 99");
+
+    auto result = pool.submit([] { return 42; });
+    if (result.get() != 42) fail("pool is not usable after an exception");
+
+    std::cout << (valid ? "Thread pool is consistent" : "Thread pool is inconsistent") << std::endl;
+    return valid ? 0 : 1;
+}
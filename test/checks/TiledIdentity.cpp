@@ -0,0 +1,37 @@
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// Tiled updateFlow and updateHeight read their cells and halos from shared memory but compute the same arithmetic,
+// so every step must end in the same grid as the kernels reading global memory, whatever the shape of the tile
+int main() {
+
+    auto tiled = HydroTest::shrinkScript(HydroTest::loadScript(), 33, 65, 60.0f);
+    auto untiled = tiled;
+    HydroTest::setDefine(untiled, "updateFlow", "TILED", 0);
+    HydroTest::setDefine(untiled, "updateHeight", "TILED", 0);
+
+    auto run = [](const Json& script) -> std::optional<HydroTest::Snapshot> {
+        auto core = HydroTest::createCore();
+        if (!core) return std::nullopt;
+
+        core->initialization(script);
+        core->setPollInterval(1);
+        while (core->step());
+        return HydroTest::snapshot(*core);
+    };
+
+    auto baseline = run(untiled);
+    if (!baseline) return HydroTest::skipped;
+
+    // Tiles of the script (16 x 16) and flat tiles whose halo rows outweigh their cells
+    auto flat = tiled;
+    for (auto& pipelineInfo : flat["pipelines"]) {
+        if (pipelineInfo["name"] == "updateFlow") pipelineInfo["specialization"] = { { "0", 64 }, { "1", 2 } };
+    }
+
+    bool same = true;
+    same &= HydroTest::identical(*baseline, *run(tiled), "tiled kernels");
+    same &= HydroTest::identical(*baseline, *run(flat), "flat tiled kernels");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include <random>
+#include <set>
+#include "HydroTest.h"
+
+namespace NH = NextHydro;
+
+// A traced run writes a Chrome trace holding host phases and the GPU passes of every step,
+// and a core that never started a trace can not stop the trace of another core
+int main() {
+
+    auto script = HydroTest::shrinkScript(HydroTest::loadScript(), 33, 65, 60.0f);
+    auto path = fs::temp_directory_path() / ("HydroCore-trace-" + std::to_string(std::random_device{}()) + ".json");
+
+    auto core = HydroTest::createCore();
+    if (!core) return HydroTest::skipped;
+    core->setTracing(path.string());
+    core->initialization(script);
+    core->setPollInterval(1);
+    for (size_t i = 0; i < 4; ++i) core->step();
+
+    bool valid = true;
+    {
+        auto other = HydroTest::createCore();
+        other->setTracing("");
+    }
+    if (!NH::Trace::enabled()) {
+        std::cout << "Trace was stopped by a core that did not start it" << std::endl;
+        valid = false;
+    }
+
+    for (size_t i = 0; i < 4; ++i) core->step();
+    core->setTracing("");
+    if (NH::Trace::enabled()) {
+        std::cout << "Trace is still running after it was stopped" << std::endl;
+        valid = false;
+    }
+
+    std::ifstream file(path);
+    auto events = Json::parse(file);
+    file.close();
+    fs::remove(path);
+
+    std::set<std::string> hostNames, gpuNames;
+    for (const auto& event : events) {
+        if (event["ph"] != "X") continue;
+        if (event["dur"].get<double>() < 0.0) {
+            std::cout << "Event <" << event["name"].get<std::string>() << "> has a negative duration" << std::endl;
+            valid = false;
+        }
+        (event["cat"] == "gpu" ? gpuNames : hostNames).insert(event["name"].get<std::string>());
+    }
+    std::cout << "Trace holds " << events.size() << " events, " << hostNames.size() << " host phases and " << gpuNames.size() << " GPU passes" << std::endl;
+
+    for (const auto& name : { "recordNode", "submit", "waitFence" }) {
+        if (hostNames.count(name)) continue;
+        std::cout << "Host phase <" << name << "> is missing" << std::endl;
+        valid = false;
+    }
+    for (const auto& name : { "boundaryHeightPass", "flowPass", "heightPass", "totalTimePass" }) {
+        if (gpuNames.count(name)) continue;
+        std::cout << "GPU pass <" << name << "> is missing" << std::endl;
+        valid = false;
+    }
+    return valid ? 0 : 1;
+}
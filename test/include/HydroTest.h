@@ -0,0 +1,202 @@
+//
+// Created by Yucheng Soku on 2024/12/02.
+//
+
+#ifndef HYDROCOREPLAYER_HYDROTEST_H
+#define HYDROCOREPLAYER_HYDROTEST_H
+
+#include <map>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include "TestConfig.h"
+#include "HydroCore/Core.h"
+
+// Helpers of the checks and benchmarks run by ctest (see test/CMakeLists.txt)
+// Every check runs a shrunken copy of run.hcs.json, small enough for software rasterisers like lavapipe
+namespace HydroTest {
+
+    namespace NH = NextHydro;
+
+    // Exit code of a check that can not run here (ctest reports it as skipped)
+    constexpr int skipped = 77;
+
+    // Storages holding the state of the shallow-water grid
+    const std::vector<std::string> gridStorages = { "scalars", "h", "hn", "q_x", "qn_x", "q_y", "qn_y" };
+
+    // Words of every compared storage, by name
+    using Snapshot = std::map<std::string, std::vector<uint32_t>>;
+
+    inline Json loadScript() {
+
+        auto path = RESOURCE_PATH / fs::path("run.hcs.json");
+        std::ifstream f(path);
+        if (!f) throw std::runtime_error("failed to open JSON file: " + path.string());
+        return Json::parse(f);
+    }
+
+    // Grid of the script cut to <rowLength> x <rows> cells, stepping until <endTime> seconds of simulated time
+    inline Json shrinkScript(Json script, uint32_t rowLength, uint32_t rows, float endTime) {
+
+        auto oldRowLength = script["decomposition"]["rowLength"].get<uint32_t>();
+        auto oldRows = script["decomposition"]["rows"].get<uint32_t>();
+        uint64_t oldCells = uint64_t(oldRowLength) * oldRows;
+
+        for (auto& storageInfo : script["storages"]) {
+            auto& resource = storageInfo["resource"];
+            if (resource.is_object() && resource["length"].get<uint64_t>() == oldCells) resource["length"] = uint64_t(rowLength) * rows;
+        }
+
+        // Resolution and rows of the whole grid held by a single core
+        for (auto& uniformInfo : script["uniforms"]) {
+            if (uniformInfo["name"] != "constants") continue;
+            auto& resource = uniformInfo["resource"];
+            resource[0] = rowLength - 1;
+            resource[1] = rows - 1;
+            resource[11] = rows;
+            resource[13] = rows;
+        }
+
+        for (auto& passInfo : script["passes"]) {
+            if (!passInfo.contains("computeScale")) continue;
+            auto& scale = passInfo["computeScale"];
+            if (scale[0].get<uint32_t>() == oldRowLength) scale[0] = rowLength;
+            if (scale[0].get<uint32_t>() == oldRowLength - 1) scale[0] = rowLength - 1;
+            if (scale[1].get<uint32_t>() == oldRows) scale[1] = rows;
+        }
+
+        for (auto& nodeInfo : script["flow"]) {
+            if (nodeInfo.contains("flag")) nodeInfo["flag"] = endTime;
+        }
+
+        script["decomposition"]["rowLength"] = rowLength;
+        script["decomposition"]["rows"] = rows;
+        return script;
+    }
+
+    inline void setDefine(Json& script, const std::string& pipeline, const std::string& name, int value) {
+
+        for (auto& pipelineInfo : script["pipelines"]) {
+            if (pipelineInfo["name"] == pipeline) pipelineInfo["defines"][name] = value;
+        }
+    }
+
+    // Core on the best Vulkan device, nullptr if there is none (the core would run on the CPU backend)
+    // Jobs that must have a device (CI on lavapipe) set HYDROCORE_REQUIRE_DEVICE, so that checks fail instead of being skipped
+    inline std::unique_ptr<NH::Core> createCore() {
+
+        auto core = std::make_unique<NH::Core>();
+        if (core->cpuBackend) {
+            if (std::getenv("HYDROCORE_REQUIRE_DEVICE")) throw std::runtime_error("no Vulkan device is available, but HYDROCORE_REQUIRE_DEVICE is set!");
+            std::cout << "No Vulkan device is available, check skipped." << std::endl;
+            return nullptr;
+        }
+        return core;
+    }
+
+    // Words of the buffer a storage name refers to, read through a host-visible copy
+    inline std::vector<uint32_t> readStorage(NH::Core& core, const std::string& name) {
+
+        auto buffer = core.currentBuffer(name);
+        if (!buffer) throw std::runtime_error("storage <" + name + "> does not exist!");
+
+        NH::Buffer readback(core.device, name + " Readback", *core.allocator,
+                            buffer->size,
+                            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+        );
+        core.copyBuffer(buffer->buffer, readback.buffer, buffer->size);
+
+        std::vector<uint32_t> words;
+        readback.readData(words);
+        readback.release();
+        return words;
+    }
+
+    inline Snapshot snapshot(NH::Core& core, const std::vector<std::string>& names = gridStorages) {
+
+        Snapshot words;
+        for (const auto& name : names) {
+            words[name] = readStorage(core, name);
+        }
+        return words;
+    }
+
+    // Words of the storage a name refers to on the CPU backend
+    inline Snapshot hostSnapshot(NH::CpuBackend& backend, const std::vector<std::string>& names = gridStorages) {
+
+        Snapshot words;
+        for (const auto& name : names) {
+            auto data = backend.storage<uint32_t>(name);
+            words[name].assign(data, data + backend.storageSize(name));
+        }
+        return words;
+    }
+
+    // Comparison of float storages within |actual - expected| <= tolerance * (1 + |expected|), words both of them hold
+    // (buffers of the device may be padded), the largest difference of every storage is reported
+    inline bool close(const Snapshot& expected, const Snapshot& actual, const std::string& label, float tolerance) {
+
+        bool same = true;
+        for (const auto& [name, expectedWords] : expected) {
+            auto it = actual.find(name);
+            if (it == actual.end()) {
+                std::cout << label << ": storage <" << name << "> is missing" << std::endl;
+                same = false;
+                continue;
+            }
+            float largest = 0.0f;
+            size_t count = std::min(expectedWords.size(), it->second.size());
+            for (size_t i = 0; i < count; ++i) {
+                NH::Flag e {}, a {};
+                e.u = expectedWords[i];
+                a.u = it->second[i];
+                float difference = std::fabs(a.f - e.f);
+                if (!(difference <= tolerance * (1.0f + std::fabs(e.f)))) same = false;
+                if (!(difference <= largest)) largest = difference;
+            }
+            std::cout << label << ": storage <" << name << "> differs by at most " << largest << std::endl;
+        }
+        return same;
+    }
+
+    // Bit-for-bit comparison, the first mismatching word of every storage is reported
+    inline bool identical(const Snapshot& expected, const Snapshot& actual, const std::string& label) {
+
+        bool same = true;
+        for (const auto& [name, expectedWords] : expected) {
+            auto it = actual.find(name);
+            if (it == actual.end()) {
+                std::cout << label << ": storage <" << name << "> is missing" << std::endl;
+                same = false;
+                continue;
+            }
+            const auto& actualWords = it->second;
+            if (actualWords.size() != expectedWords.size()) {
+                std::cout << label << ": storage <" << name << "> holds " << actualWords.size() << " words instead of " << expectedWords.size() << std::endl;
+                same = false;
+                continue;
+            }
+            for (size_t i = 0; i < expectedWords.size(); ++i) {
+                if (actualWords[i] == expectedWords[i]) continue;
+
+                NH::Flag e {}, a {};
+                e.u = expectedWords[i];
+                a.u = actualWords[i];
+                std::cout << label << ": storage <" << name << "> differs at word " << i << " (" << a.f << " instead of " << e.f << ")" << std::endl;
+                same = false;
+                break;
+            }
+        }
+        if (same) std::cout << label << ": identical" << std::endl;
+        return same;
+    }
+}
+
+#endif //HYDROCOREPLAYER_HYDROTEST_H
@@ -1,23 +1,66 @@
 #include <vector>
 #include <chrono>
+#include <iomanip>
 #include <iostream>
 #include "TestConfig.h"
 #include "HydroCore/Core.h"
+#include "HydroCore/Cluster.h"
 
 namespace NH = NextHydro;
-int main() {
+int main(int argc, char** argv) {
 
     // Script resource
     fs::path jsonPath = RESOURCE_PATH / fs::path("run.hcs.json");
 
-    // Launch GPGPU core
-    auto core = new NH::Core();
+    // <--strips N> splits the grid into N row strips, each run by its own logical device on the best physical device
+    size_t stripCount = 0;
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::string(argv[i]) == "--strips") stripCount = std::stoul(argv[i + 1]);
+    }
+    if (stripCount) {
+        NH::Cluster cluster(std::vector<int32_t>(stripCount, -1));
+        cluster.initialization(jsonPath.string());
+
+        auto start = std::chrono::high_resolution_clock::now();
+        while(cluster.step());
+        std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+        std::cout << "Run time (" << stripCount << " strips): " << duration.count() << "ms" << std::endl;
+
+        auto buffer = cluster.strips.front().core->name_buffer_map["scalars"].get();
+        auto outputArray = buffer->view<float_t>(0, 3);
+        outputArray.invalidate();
+        for (const auto& value : outputArray) {
+            std::cout << value << std::endl;
+        }
+        return 0;
+    }
+
+    // Launch GPGPU core, <--autotune> tunes workgroup sizes of the device before running, <--profile> times every pass,
+    // <--trace> writes the host and GPU timeline to trace.json (open it in ui.perfetto.dev),
+    // <--cpu> runs the script with the native kernels of the CPU backend (used anyway when no Vulkan device exists)
+    int32_t deviceIndex = -1;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--cpu") deviceIndex = NH::Core::hostDevice;
+    }
+    auto core = new NH::Core(deviceIndex);
+    bool profiling = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--autotune") core->setAutotune(true);
+        if (std::string(argv[i]) == "--profile") profiling = true;
+        if (std::string(argv[i]) == "--trace") core->setTracing("trace.json");
+    }
+    if (profiling) core->setProfiling(true, true);
 
     // Parse and run script
 //    core->parseScript(jsonPath.c_str());
 //    core->runScript();
 
+    // Shaders are compiled on the first launch only, later launches read them from the shader cache
+    auto initStart = std::chrono::high_resolution_clock::now();
     core->initialization(jsonPath.string());
+    std::chrono::duration<double, std::milli> initDuration = std::chrono::high_resolution_clock::now() - initStart;
+    std::cout << "Initialization time: " << initDuration.count() << "ms" << std::endl;
+    core->reportMemory();
     auto start = std::chrono::high_resolution_clock::now();
 
     while(core->step());
@@ -28,15 +71,33 @@ int main() {
     std::cout << "Run time: " << duration.count() << "ms" << std::endl;
 
     // Check result
-    auto buffer = core->name_buffer_map["scalars"].get();
-    std::vector<float_t> outputArray;
-    buffer->readData(outputArray);
-
     std::cout << "\n==================== Computation Result ====================" << std::endl;
-    outputArray.resize(3);
-    for (const auto& value : outputArray) {
-        std::cout << value << std::endl;
+    if (core->cpuBackend) {
+        auto scalars = core->cpuBackend->storage<float_t>("scalars");
+        for (size_t i = 0; i < 3; ++i) {
+            std::cout << scalars[i] << std::endl;
+        }
+    } else {
+        auto buffer = core->name_buffer_map["scalars"].get();
+        auto outputArray = buffer->view<float_t>(0, 3);
+        outputArray.invalidate();
+        for (const auto& value : outputArray) {
+            std::cout << value << std::endl;
+        }
+    }
+
+    if (profiling) {
+        std::cout << "\n==================== Pass Profile ====================" << std::endl;
+        std::cout << std::left << std::setw(24) << "pass" << std::right << std::setw(10) << "count" << std::setw(12) << "mean(ms)"
+                  << std::setw(12) << "p50(ms)" << std::setw(12) << "p99(ms)" << std::setw(12) << "total(ms)" << std::endl;
+        for (const auto& statistics : core->profile()) {
+            std::cout << std::left << std::setw(24) << statistics.pass << std::right << std::setw(10) << statistics.count
+                      << std::fixed << std::setprecision(4)
+                      << std::setw(12) << statistics.meanMs << std::setw(12) << statistics.p50Ms
+                      << std::setw(12) << statistics.p99Ms << std::setw(12) << statistics.totalMs << std::endl;
+        }
     }
 
+    delete core;
     return 0;
 }